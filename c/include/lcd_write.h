@@ -37,6 +37,10 @@
 #define INIT_ROWS    10
 #define INIT_COLS    6
 
+#define LCD_MAX_ROWS         4
+#define LCD_MAX_COLS         80
+#define LCD_FRAME_SIZE       (LCD_MAX_ROWS * (LCD_MAX_COLS + 1) * OUTBUFFSIZE)
+
 #define DEFAULT_MAX_COLS     16
 #define DEFAULT_MAX_ROWS     4
 #define DEFAULT_DEV_ADDR     0x27
@@ -44,6 +48,23 @@
 #define MAJOR_NUMBER         89
 
 
+/* Display handle: geometry and row addresses are computed once, at open
+   time. Updates are encoded in a stack buffer and leave in a single write():
+   on a bus up to 400 kHz the bytes between two instructions last longer
+   than an instruction takes to run, so no sleep is needed in between. */
+typedef struct {
+    int            fd;
+    size_t         rows,
+                   cols;
+    unsigned char  addrs[LCD_MAX_ROWS];
+} lcd_t;
+
+int  lcd_open(lcd_t* lcd, const char *device, int addr, size_t rows, size_t cols, bool reset);
+void lcd_close(lcd_t* lcd);
+int  lcd_write_line(const lcd_t* lcd, unsigned int row, const char* msg, bool clean);
+int  lcd_write_at(const lcd_t* lcd, unsigned int row, unsigned int col, const char* msg);
+int  lcd_write_frame(const lcd_t* lcd, const char* const* lines, size_t count);
+
 void hexCmd(int fd, unsigned char cmd, unsigned char mode);
 void writeLine(int fd, size_t maxRows, unsigned char maxCols, const char* const msg, unsigned int row, bool clean);
 int init(const char *device, int addr, bool reset);
@@ -20,83 +20,159 @@
 
 #include <lcd_write.h>	
 
-#include <assert.h>
+#define LCD_BACKLIGHT   0x08
+#define EN              0x04
+#define MODE_RS         0x01
 
-void hexCmd(int fd, unsigned char cmd, unsigned char mode){
-    unsigned char output[OUTBUFFSIZE];
-    const unsigned char LCD_BACKLIGHT=0x08;
-    const unsigned char EN=0x4;
-
-    unsigned char first=(mode | ( cmd & 0xF0 ) );
-    unsigned char second=(mode | ( (cmd << 4 ) & 0xF0 ) );
+/* Execution times in microseconds, datasheet figures with a margin. */
+#define EXEC_US         50
+#define CLEAR_HOME_US   2000
+#define INIT_LONG_US    4500
+#define INIT_SHORT_US   150
 
-    output[0]=(first | LCD_BACKLIGHT );
-    output[1]=(first | EN | LCD_BACKLIGHT);
-    output[2]=((first & (~EN)) | LCD_BACKLIGHT );
+static size_t encode(unsigned char* out, unsigned char cmd, unsigned char mode){
+    unsigned char first=(mode | ( cmd & 0xF0 ) ),
+                  second=(mode | ( (cmd << 4 ) & 0xF0 ) );
 
-    output[3]=(second | LCD_BACKLIGHT );
-    output[4]=(second | EN | LCD_BACKLIGHT );
-    output[5]=((second & (~EN)) | LCD_BACKLIGHT );
+    out[0]=(first | LCD_BACKLIGHT );
+    out[1]=(first | EN | LCD_BACKLIGHT);
+    out[2]=((first & (~EN)) | LCD_BACKLIGHT );
 
-    for(int col=0; col<OUTBUFFSIZE; col++){
-	     if (write(fd, output+col, sizeof(unsigned char)) != sizeof(unsigned char)) 
-		     fprintf(stderr, "Error: Failed to write cmd to the i2c bus. %s\n", strerror(errno));
+    out[3]=(second | LCD_BACKLIGHT );
+    out[4]=(second | EN | LCD_BACKLIGHT );
+    out[5]=((second & (~EN)) | LCD_BACKLIGHT );
 
-         usleep(50000);
-    }
+    return OUTBUFFSIZE;
 }
 
-void writeLine(int fd, size_t maxRows, unsigned char maxCols, const char* const msg, unsigned int row, bool clean) {
-    const unsigned char   MAX_BUFF =  64;
-    assert(maxCols + 1 <= MAX_BUFF);
+/* Address command plus width cells: msg, then blanks. */
+static size_t encodeRow(const lcd_t* lcd, unsigned char* out, unsigned int row, unsigned int col,
+                        const char* msg, size_t width){
+    size_t len = 0,
+           pos = 0;
+
+    while(len < width && msg[len] != '\0')
+        len++;
 
-    // add ctrl params
-    unsigned char* ADDRS = malloc( maxRows * sizeof(unsigned char));
+    pos += encode(out + pos, (unsigned char)(lcd->addrs[row-1] + col), 0);
+    for(size_t idx=0; idx<width; idx++)
+        pos += encode(out + pos, idx < len ? (unsigned char)msg[idx] : ' ', MODE_RS);
+
+    return pos;
+}
+
+static int flush(const lcd_t* lcd, const unsigned char* buff, size_t len){
+    if (write(lcd->fd, buff, len) != (ssize_t)len){
+        fprintf(stderr, "Error: Failed to write to the i2c bus: %s\n", strerror(errno));
+        return -1;
+    }
+    usleep(EXEC_US);
+    return 0;
+}
 
-    if(ADDRS == NULL){
-		     fprintf(stderr, "Error: ADDRS allocation\n");
-             exit(1);
+static int setup(lcd_t* lcd, int fd, size_t rows, size_t cols){
+    if(cols < 1 || cols > LCD_MAX_COLS){
+        fprintf(stderr, "Error: not compatible columns number %zu\n", cols);
+        return -1;
     }
 
-    switch(maxRows){
+    lcd->fd   = fd;
+    lcd->rows = rows;
+    lcd->cols = cols;
+    switch(rows){
         case 4:
-                ADDRS[0] = 0x80;
-                ADDRS[1] = 0xC0;
-                ADDRS[2] = 0x80+maxCols;
-                ADDRS[3] = 0xC0+maxCols;
-        break;
+                lcd->addrs[2] = (unsigned char)(0x80 + cols);
+                lcd->addrs[3] = (unsigned char)(0xC0 + cols);
+                /* fall through */
         case 2:
-                ADDRS[0] = 0x80;
-                ADDRS[1] = 0xC0;
-        break;
+                lcd->addrs[1] = 0xC0;
+                /* fall through */
         case 1:
-                ADDRS[0] = 0x80;
+                lcd->addrs[0] = 0x80;
         break;
         default:
-                // never here
-                ADDRS[0]  = 0x00;
-		        fprintf(stderr, "Error: not compatible rows number %ld\n", maxRows);
-                exit(1);
+		        fprintf(stderr, "Error: not compatible rows number %zu\n", rows);
+                return -1;
     }
+    return 0;
+}
+
+int lcd_open(lcd_t* lcd, const char *device, int addr, size_t rows, size_t cols, bool reset){
+    if(setup(lcd, -1, rows, cols) < 0)
+        return -1;
+
+    lcd->fd = init(device, addr, reset);
+    return lcd->fd < 0 ? -1 : 0;
+}
+
+void lcd_close(lcd_t* lcd){
+    if(lcd->fd >= 0)
+        close(lcd->fd);
+    lcd->fd = -1;
+}
 
-    char buff[maxCols + 1];
-    memset(buff, 0, sizeof(buff));
+int lcd_write_line(const lcd_t* lcd, unsigned int row, const char* msg, bool clean){
+    unsigned char buff[(LCD_MAX_COLS + 1) * OUTBUFFSIZE];
+    size_t        width = lcd->cols;
 
-    if( strlen(msg) >= maxCols ){
-        memcpy(buff, msg, maxCols);
-    }else{
-        if(clean)
-           memset(buff, ' ', sizeof(buff) - 1);
-        memcpy(buff, msg, strlen(msg));
+    if(row < 1 || row > lcd->rows){
+        fprintf(stderr, "Error: invalid row number %u\n", row);
+        return -1;
+    }
+    if(!clean){
+        width = strlen(msg);
+        if(width > lcd->cols)
+            width = lcd->cols;
     }
-    const unsigned char MODE_RS=0x1;
 
-    hexCmd(fd, ADDRS[row-1], 0);
-    usleep(50000);
-    for(int col=0; col<(int)strlen(buff); col++)
-       hexCmd(fd, buff[col], MODE_RS);
+    return flush(lcd, buff, encodeRow(lcd, buff, row, 0, msg, width));
+}
 
-    free(ADDRS);
+int lcd_write_at(const lcd_t* lcd, unsigned int row, unsigned int col, const char* msg){
+    unsigned char buff[(LCD_MAX_COLS + 1) * OUTBUFFSIZE];
+    size_t        width = strlen(msg);
+
+    if(row < 1 || row > lcd->rows || col >= lcd->cols){
+        fprintf(stderr, "Error: invalid position %u,%u\n", row, col);
+        return -1;
+    }
+    if(width > lcd->cols - col)
+        width = lcd->cols - col;
+
+    return flush(lcd, buff, encodeRow(lcd, buff, row, col, msg, width));
+}
+
+int lcd_write_frame(const lcd_t* lcd, const char* const* lines, size_t count){
+    unsigned char buff[LCD_FRAME_SIZE];
+    size_t        len = 0;
+
+    if(count > lcd->rows){
+        fprintf(stderr, "Error: more rows than the display has\n");
+        return -1;
+    }
+    for(size_t row=0; row<count; row++)
+        len += encodeRow(lcd, buff + len, (unsigned int)(row + 1), 0, lines[row], lcd->cols);
+
+    return flush(lcd, buff, len);
+}
+
+void hexCmd(int fd, unsigned char cmd, unsigned char mode){
+    unsigned char output[OUTBUFFSIZE];
+
+    encode(output, cmd, mode);
+    if (write(fd, output, OUTBUFFSIZE) != OUTBUFFSIZE) 
+        fprintf(stderr, "Error: Failed to write cmd to the i2c bus. %s\n", strerror(errno));
+
+    usleep(mode == 0 && (cmd == 0x01 || (cmd & 0xFE) == 0x02) ? CLEAR_HOME_US : EXEC_US);
+}
+
+void writeLine(int fd, size_t maxRows, unsigned char maxCols, const char* const msg, unsigned int row, bool clean) {
+    lcd_t lcd;
+
+    if(setup(&lcd, fd, maxRows, maxCols) < 0)
+        exit(1);
+
+    lcd_write_line(&lcd, row, msg, clean);
 }
 
 int init(const char *device, int addr, bool reset){
@@ -112,6 +188,12 @@ int init(const char *device, int addr, bool reset){
         { 0x08,0x0c,0x08,0x18,0x1c,0x18 },
         { 0x08,0x0c,0x08,0x28,0x2c,0x28 }
     };
+    /* Wait after each instruction of the sequence: the first two 8 bit
+       function sets have their own, longer, times; clear and home 1.52 ms. */
+    const unsigned int  initDelays[INIT_ROWS] = {
+        INIT_LONG_US, INIT_SHORT_US, EXEC_US, EXEC_US, EXEC_US,
+        EXEC_US, CLEAR_HOME_US, EXEC_US, CLEAR_HOME_US, CLEAR_HOME_US
+    };
 
     // Open the I2C Bus 
     int fdI2c = open(device, O_RDWR);
@@ -122,19 +204,17 @@ int init(const char *device, int addr, bool reset){
 	
 	if (ioctl(fdI2c, I2C_SLAVE, addr) < 0) {
 		fprintf(stderr, "Failed to acquire bus access and/or talk to slave. %s\n", strerror(errno));
+        close(fdI2c);
 		return -1;
 	}
     if(reset){
         for(int row=0; row<INIT_ROWS; row++){
-            for(int col=0; col<INIT_COLS; col++){
-	            if (write(fdI2c, &initSequence[row][col], sizeof(unsigned char)) != sizeof(unsigned char)) 
-		            fprintf(stderr, "Error: Failed to write to the i2c bus: %s\n", strerror(errno));
+	        if (write(fdI2c, initSequence[row], INIT_COLS) != INIT_COLS) 
+		        fprintf(stderr, "Error: Failed to write to the i2c bus: %s\n", strerror(errno));
 	            
-                usleep(50000);
-            }
+            usleep(initDelays[row]);
         }
     }
 
     return fdI2c;
 }
- 
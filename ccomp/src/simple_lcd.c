@@ -90,12 +90,12 @@ int main(int argc, char** argv){
     if(stat(device, &sbuf) == -1)                      nodev();
     if(major(sbuf.st_dev != majorno))                  nodev();
 
-    int            fdI2c = init(device, addr, hasInit);
-	if (fdI2c < 0) nobus();
+    lcd_t          lcd;
+    if (lcd_open(&lcd, device, addr, (size_t)rowMax, (size_t)colMax, hasInit) < 0) nobus();
 
-    writeLine(fdI2c, rowMax, colMax, text, row, true); 
+    if (lcd_write_line(&lcd, (unsigned int)row, text, true) < 0) nobus();
 
-    close(fdI2c);
+    lcd_close(&lcd);
     return 0;
 }
 
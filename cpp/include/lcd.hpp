@@ -25,37 +25,116 @@
 #include <sys/ioctl.h>
 
 #include <string>
+#include <string_view>
 #include <array>
+#include <vector>
 #include <iostream>
+#include <memory>
+#include <atomic>
 
-#define  anyexcept noexcept(false)
+#include <lcdTiming.hpp>
+#include <lcdTransport.hpp>
+#include <lcdEncode.hpp>
+#include <lcdDiff.hpp>
+#include <lcdRecord.hpp>
 
 namespace lcd_hitachi_driver {
 
+    // Snapshot of the counters of one driver, see LcdDriver::stats().
+    struct LcdStats {
+        uint64_t  bytes,            // bus bytes, written and read
+                  syscalls,         // write()/read()/ioctl() issued by the transport
+                  transactions,     // bus transactions
+                  sleptNs,          // waiting for instruction deadlines
+                  busNs,            // inside the transport, syscalls included
+                  statusReads,      // busy flag reads
+                  retries,
+                  errors;           // failed transactions
+    };
+
     class LcdDriver {
        public:
+           static const unsigned long DEFAULT_POLL_TIMEOUT { 10000000 };    // ns
+           static const unsigned int  DEFAULT_RETRIES      { 3 };
+           static const unsigned long DEFAULT_BACKOFF      { 1000000 };     // ns, doubled at every retry
+           static const size_t        CGRAM_SLOTS          { 8 };
+           using Glyph = std::array<unsigned char, 8>;                     // 5x8 pixel rows, bits 4-0
+
            LcdDriver(int addr=0x27, size_t rws=4, 
                      size_t cols=16, const std::string& dev="/dev/i2c-1")    anyexcept;
+           LcdDriver(std::unique_ptr<Transport> tr, size_t rws=4, 
+                     size_t cols=16)                                         anyexcept;
            ~LcdDriver(void)                                                  noexcept;
            void init(void)                                                   const anyexcept;
-           void writeLine(std::string msg, unsigned int row, bool clean)     const anyexcept; 
+           void writeLine(std::string_view msg, unsigned int row, bool clean)
+                                                                             const anyexcept;
+           void writeFrame(const std::vector<std::string>& frame)            const anyexcept;
+           void invalidate(void)                                             const noexcept;
+           void command(unsigned char cmd)                                   const anyexcept;
+           void writeDdram(unsigned char addr, const std::string& data)      const anyexcept;
+           void writeCgram(unsigned char slot, const Glyph& glyph)           const anyexcept;
+           void setTiming(const TimingProfile& prof)                         noexcept;
+           void setBusyPolling(bool on, unsigned long timeoutNs=DEFAULT_POLL_TIMEOUT)
+                                                                             noexcept;
+           bool isBusyPolling(void)                                          const noexcept;
+           unsigned char readStatus(void)                                    const anyexcept;
+           const TimingProfile& getTiming(void)                              const noexcept;
+           uint64_t getSleptNs(void)                                         const noexcept;
+           LcdStats stats(void)                                              const noexcept;
+           void resetStats(void)                                             const noexcept;
+           void setRecorder(std::shared_ptr<trace::TraceWriter> rec)         noexcept;
+           void setRetry(unsigned int attempts, unsigned long backoffNs=DEFAULT_BACKOFF)
+                                                                             noexcept;
+           size_t getRows(void)                                              const noexcept;
+           size_t getColumns(void)                                           const noexcept;
 
        private:
-           static const size_t OUTPUT_BUFF_SIZE { 6 };
+           static const size_t OUTPUT_BUFF_SIZE { encoding::SEQ_SIZE };
            static const size_t ADDRESSES_SIZE   { 4 };
            static const size_t INIT_COLS        { 6 };
            static const size_t INIT_ROWS        { 10 };
+           static const size_t RESYNC_ROWS      { 4 };
+           static const size_t NIBBLE_SIZE      { 3 };
+           // Port values of a read cycle: D7-D4 released high, R/W set, EN low/high.
+           static const unsigned char READ_IDLE { 0xFA };
+           static const unsigned char READ_EN   { 0xFE };
+           static const unsigned char BUSY_FLAG { 0x80 };
+
+           struct TxMark {
+               size_t  end;
+               Delay   delay;
+           };
 
-           const int           I2C_SLAVE        { 0x0703 };
-           const unsigned char LCD_BACKLIGHT    { 0x08 };
-           const unsigned char EN               { 0x4 };
+           // Always on: relaxed increments, stats() may run on any thread.
+           struct Counters {
+               std::atomic<uint64_t>  bytes        { 0 },
+                                      syscalls     { 0 },
+                                      transactions { 0 },
+                                      sleptNs      { 0 },
+                                      busNs        { 0 },
+                                      statusReads  { 0 },
+                                      retries      { 0 },
+                                      errors       { 0 };
+           };
 
            size_t       rows,
                         columns;
-           int          fdI2c,
-                        address;
-           std::string  device; 
-           mutable std::array<unsigned char, OUTPUT_BUFF_SIZE> output;
+           std::unique_ptr<Transport>                bus;
+           mutable std::vector<unsigned char>        txBuff;
+           mutable std::vector<TxMark>               txMarks;
+           mutable std::vector<unsigned char>        spareBuff;      // update set aside by recover()
+           mutable std::vector<TxMark>               spareMarks;
+           TimingProfile                             timing;
+           mutable Pacer                             pacer;
+           mutable Counters                          counters;
+           std::shared_ptr<trace::TraceWriter>       recorder;
+           mutable trace::Op                         apiOp;          // call being served, for the trace
+           mutable bool                              pollBusy;
+           unsigned long                             pollTimeoutNs;
+           unsigned int                              retryLimit;
+           unsigned long                             retryBackoffNs;
+           mutable std::vector<char>                 shadow;         // DDRAM content, rows x columns
+           mutable std::vector<unsigned char>        shadowValid;    // 0: content unknown, must be written
            std::array<unsigned char, ADDRESSES_SIZE> addrs;
            std::array<std::array<unsigned char, INIT_COLS>, INIT_ROWS> initMatrix {{
                {{ 0x08,0x0c,0x08,0x38,0x3c,0x38 }},
@@ -69,7 +148,38 @@ namespace lcd_hitachi_driver {
                {{ 0x08,0x0c,0x08,0x18,0x1c,0x18 }},
                {{ 0x08,0x0c,0x08,0x28,0x2c,0x28 }}
             }};
+           std::array<Delay, INIT_ROWS> initDelays {{
+               Delay::INIT_LONG,  Delay::INIT_SHORT, Delay::EXEC, Delay::EXEC,
+               Delay::EXEC,       Delay::EXEC,       Delay::CLEAR_HOME,
+               Delay::EXEC,       Delay::CLEAR_HOME, Delay::CLEAR_HOME
+            }};
+           // Single nibbles: 0x3 three times, then 0x2. The first one may complete
+           // a byte left half sent: a return home at worst, hence its wait.
+           std::array<std::array<unsigned char, NIBBLE_SIZE>, RESYNC_ROWS> resyncMatrix {{
+               {{ 0x38,0x3c,0x38 }},
+               {{ 0x38,0x3c,0x38 }},
+               {{ 0x38,0x3c,0x38 }},
+               {{ 0x28,0x2c,0x28 }}
+            }};
+           std::array<Delay, RESYNC_ROWS> resyncDelays {{
+               Delay::CLEAR_HOME, Delay::INIT_SHORT, Delay::INIT_SHORT, Delay::EXEC
+            }};
 
             void hexCmd(unsigned char cmd, unsigned char mode)             const anyexcept;
+            void sendBuffer(bool mayPoll=true)                             const anyexcept;
+            void flushBuffer(bool mayPoll)                                 const anyexcept;
+            void discard(void)                                             const noexcept;
+            void recover(void)                                             const anyexcept;
+            void waitReady(bool mayPoll)                                   const anyexcept;
+            void pace(void)                                                const noexcept;
+            void transfer(unsigned char delay, const unsigned char* out, size_t outLen,
+                          unsigned char* in=nullptr, size_t inLen=0)       const anyexcept;
+            void queueRow(std::string_view msg, unsigned int row, bool clean)
+                                                                           const anyexcept;
+            void queueData(const char* data, size_t len)                   const anyexcept;
+            void queueBytes(const unsigned char* data, size_t len, Delay dl) const anyexcept;
     };
+
+    // I2C address as given on the command line: decimal, or hexadecimal with the 0x prefix.
+    int parseAddress(const std::string& text)                                anyexcept;
 }
\ No newline at end of file
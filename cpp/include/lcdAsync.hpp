@@ -0,0 +1,357 @@
+/*
+# -----------------------------------------------------------------
+# simple_lcd - a command line tools to print message using Hitachi  
+#              HD44780 LCDs connected over I2C on Linux.                   
+# Copyright (C) 2020  Gabriele Bonacini
+#
+# This program is free software for no profit use; you can redistribute
+# it and/or modify it under the terms of the GNU General Public License
+# as published by the Free Software Foundation; either version 2 of
+# the License, or (at your option) any later version.
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+# You should have received a copy of the GNU General Public License
+# along with this program; if not, write to the Free Software Foundation,
+# Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301  USA
+# -----------------------------------------------------------------
+*/
+
+#pragma once
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <functional>
+#include <atomic>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <exception>
+#include <cstdint>
+
+#include <lcd.hpp>
+
+namespace lcd_hitachi_driver {
+
+    // Bounded lock-free multi producer / multi consumer ring (D. Vyukov's
+    // sequence-per-cell design). push() and pop() never block and never
+    // allocate; a failed push() leaves the value untouched.
+    template<typename T>
+    class BoundedRing {
+        public:
+            explicit BoundedRing(size_t minCapacity)                          anyexcept;
+            BoundedRing(const BoundedRing&)                                   = delete;
+            BoundedRing& operator=(const BoundedRing&)                        = delete;
+
+            bool    push(T& value)                                            noexcept;
+            bool    pop(T& value)                                             noexcept;
+            bool    empty(void)                                               const noexcept;
+            bool    full(void)                                                const noexcept;
+            size_t  capacity(void)                                            const noexcept;
+
+        private:
+            struct Cell {
+                std::atomic<size_t>  seq;
+                T                    data;
+            };
+
+            size_t                   mask;
+            std::unique_ptr<Cell[]>  cells;
+            alignas(64) std::atomic<size_t>  enqPos;
+            alignas(64) std::atomic<size_t>  deqPos;
+    };
+
+    template<typename T>
+    BoundedRing<T>::BoundedRing(size_t minCapacity) anyexcept
+      : mask{0}, enqPos{0}, deqPos{0}
+    {
+        size_t size { 2 };
+        while(size < minCapacity)
+            size <<= 1;
+        mask  = size - 1;
+        cells = std::make_unique<Cell[]>(size);
+        for(size_t idx { 0 }; idx < size; ++idx)
+            cells[idx].seq.store(idx, std::memory_order_relaxed);
+    }
+
+    template<typename T>
+    bool BoundedRing<T>::push(T& value) noexcept{
+        size_t pos { enqPos.load(std::memory_order_relaxed) };
+        while(true){
+            Cell&     cell { cells[pos & mask] };
+            size_t    seq  { cell.seq.load(std::memory_order_acquire) };
+            intptr_t  diff { static_cast<intptr_t>(seq) - static_cast<intptr_t>(pos) };
+            if(diff == 0){
+                if(enqPos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)){
+                    cell.data = std::move(value);
+                    cell.seq.store(pos + 1, std::memory_order_release);
+                    return true;
+                }
+            }else if(diff < 0){
+                return false;
+            }else{
+                pos = enqPos.load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+    template<typename T>
+    bool BoundedRing<T>::pop(T& value) noexcept{
+        size_t pos { deqPos.load(std::memory_order_relaxed) };
+        while(true){
+            Cell&     cell { cells[pos & mask] };
+            size_t    seq  { cell.seq.load(std::memory_order_acquire) };
+            intptr_t  diff { static_cast<intptr_t>(seq) - static_cast<intptr_t>(pos + 1) };
+            if(diff == 0){
+                if(deqPos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)){
+                    value = std::move(cell.data);
+                    cell.seq.store(pos + mask + 1, std::memory_order_release);
+                    return true;
+                }
+            }else if(diff < 0){
+                return false;
+            }else{
+                pos = deqPos.load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+    template<typename T>
+    bool BoundedRing<T>::empty(void) const noexcept{
+        return enqPos.load(std::memory_order_acquire) == deqPos.load(std::memory_order_acquire);
+    }
+
+    template<typename T>
+    bool BoundedRing<T>::full(void) const noexcept{
+        return enqPos.load(std::memory_order_acquire) - deqPos.load(std::memory_order_acquire) > mask;
+    }
+
+    template<typename T>
+    size_t BoundedRing<T>::capacity(void) const noexcept{
+        return mask + 1;
+    }
+
+    // Single consumer thread draining a BoundedRing, shared by the front ends
+    // that hand updates to a bus: producers only wait when the ring is full,
+    // flush() waits for everything submitted so far. T has a weight member,
+    // the number of submissions an item stands for: the consumer may fold
+    // queued items (pop()) into the one it holds, and a producer may drop
+    // them (pop() and retire()) or take them out and queue them again
+    // (pop() and push()). Errors raised by apply are reported by the next
+    // flush().
+    template<typename T>
+    class BusWorker {
+        public:
+            using Apply = std::function<void(T&)>;
+
+            explicit BusWorker(size_t capacity)                               anyexcept;
+            ~BusWorker(void)                                                  noexcept;
+            BusWorker(const BusWorker&)                                       = delete;
+            BusWorker& operator=(const BusWorker&)                            = delete;
+
+            void    start(Apply fn)                                           anyexcept;
+            void    stop(void)                                                noexcept;
+            // onFull(item) runs while the ring has no room for item: it waits
+            // (waitRoom()), makes room or folds the queue into item.
+            template<typename OnFull>
+            void    submit(T& item, OnFull&& onFull)                          anyexcept;
+            void    waitRoom(void)                                            anyexcept;
+            bool    pop(T& item)                                              noexcept;
+            bool    push(T& item)                                             noexcept;
+            void    retire(uint64_t weight)                                   noexcept;
+            void    flush(void)                                               anyexcept;
+
+        private:
+            BoundedRing<T>               ring;
+            std::atomic<uint64_t>        submitted,
+                                         completed;
+            std::atomic<bool>            stopping,
+                                         idle;
+            std::atomic<unsigned int>    waiters;
+            std::mutex                   waitLock;
+            std::condition_variable      wakeBus,
+                                         progress;
+            std::exception_ptr           busError;
+            Apply                        apply;
+            std::thread                  worker;
+
+            void    run(void)                                                 noexcept;
+    };
+
+    template<typename T>
+    BusWorker<T>::BusWorker(size_t capacity) anyexcept
+      : ring{capacity}, submitted{0}, completed{0}, stopping{false}, idle{false}, waiters{0}
+    {}
+
+    template<typename T>
+    BusWorker<T>::~BusWorker(void) noexcept{
+        stop();
+    }
+
+    template<typename T>
+    void BusWorker<T>::start(Apply fn) anyexcept{
+        if(worker.joinable())
+            return;
+        apply  = std::move(fn);
+        worker = std::thread(&BusWorker::run, this);
+    }
+
+    template<typename T>
+    void BusWorker<T>::stop(void) noexcept{
+        if(!worker.joinable())
+            return;
+        {
+            std::lock_guard<std::mutex> lk(waitLock);
+            stopping.store(true);
+            wakeBus.notify_one();
+        }
+        worker.join();
+    }
+
+    template<typename T>
+    template<typename OnFull>
+    void BusWorker<T>::submit(T& item, OnFull&& onFull) anyexcept{
+        submitted.fetch_add(item.weight);
+
+        while(!ring.push(item))
+            onFull(item);
+
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if(idle.load()){
+            std::lock_guard<std::mutex> lk(waitLock);
+            wakeBus.notify_one();
+        }
+    }
+
+    template<typename T>
+    void BusWorker<T>::waitRoom(void) anyexcept{
+        waiters.fetch_add(1);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        {
+            std::unique_lock<std::mutex> lk(waitLock);
+            progress.wait(lk, [&]{ return !ring.full(); });
+        }
+        waiters.fetch_sub(1);
+    }
+
+    template<typename T>
+    bool BusWorker<T>::pop(T& item) noexcept{
+        return ring.pop(item);
+    }
+
+    template<typename T>
+    bool BusWorker<T>::push(T& item) noexcept{
+        return ring.push(item);
+    }
+
+    template<typename T>
+    void BusWorker<T>::retire(uint64_t weight) noexcept{
+        completed.fetch_add(weight);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if(waiters.load() > 0){
+            std::lock_guard<std::mutex> lk(waitLock);
+            progress.notify_all();
+        }
+    }
+
+    template<typename T>
+    void BusWorker<T>::flush(void) anyexcept{
+        const uint64_t target { submitted.load() };
+
+        waiters.fetch_add(1);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        {
+            std::unique_lock<std::mutex> lk(waitLock);
+            progress.wait(lk, [&]{ return completed.load() >= target; });
+        }
+        waiters.fetch_sub(1);
+
+        std::exception_ptr err;
+        {
+            std::lock_guard<std::mutex> lk(waitLock);
+            std::swap(err, busError);
+        }
+        if(err)
+            std::rethrow_exception(err);
+    }
+
+    template<typename T>
+    void BusWorker<T>::run(void) noexcept{
+        while(true){
+            T item;
+            if(!ring.pop(item)){
+                std::unique_lock<std::mutex> lk(waitLock);
+                if(stopping.load() && ring.empty())
+                    return;
+                idle.store(true);
+                std::atomic_thread_fence(std::memory_order_seq_cst);
+                wakeBus.wait(lk, [&]{ return stopping.load() || !ring.empty(); });
+                idle.store(false);
+                continue;
+            }
+
+            try{
+                apply(item);
+            } catch (...) {
+                std::lock_guard<std::mutex> lk(waitLock);
+                busError = std::current_exception();
+            }
+            retire(item.weight);
+        }
+    }
+
+    // What a producer does when the queue is full.
+    enum class Backpressure : unsigned char {
+        BLOCK,          // wait for the bus thread to make room
+        DROP_OLDEST,    // discard the oldest queued update, if a newer one rewrites it
+        COALESCE        // fold the queue and the new update into one
+    };
+
+    // Non-blocking front end of an LcdDriver: updates are queued and a single
+    // bus thread applies them. Errors raised on the bus thread are reported by
+    // the next flush().
+    class AsyncLcdDriver {
+        public:
+            AsyncLcdDriver(std::unique_ptr<LcdDriver> drv, size_t capacity=64,
+                           Backpressure bp=Backpressure::BLOCK)               anyexcept;
+            ~AsyncLcdDriver(void)                                             noexcept;
+            AsyncLcdDriver(const AsyncLcdDriver&)                             = delete;
+            AsyncLcdDriver& operator=(const AsyncLcdDriver&)                  = delete;
+
+            void      init(void)                                              anyexcept;
+            void      writeLine(std::string msg, unsigned int row, bool clean) anyexcept;
+            void      writeFrame(const std::vector<std::string>& frame)       anyexcept;
+            void      flush(void)                                             anyexcept;
+
+            uint64_t  getDropped(void)                                        const noexcept;
+            uint64_t  getCoalesced(void)                                      const noexcept;
+
+        private:
+            struct RowOp {
+                bool          set,
+                              clean;
+                std::string   text;
+            };
+
+            // A batch of row writes, optionally preceded by an init; weight is
+            // the number of submissions it stands for.
+            struct Update {
+                bool                init;
+                std::vector<RowOp>  rows;
+                uint64_t            weight;
+            };
+
+            std::unique_ptr<LcdDriver>   driver;
+            Backpressure                 policy;
+            std::atomic<uint64_t>        dropped,
+                                         coalesced;
+            BusWorker<Update>            worker;
+
+            void    submit(Update& upd)                                       anyexcept;
+            void    apply(Update& upd)                                        anyexcept;
+            static void merge(Update& older, Update& newer)                   noexcept;
+            static bool supersedes(const Update& newer, const Update& older)  noexcept;
+    };
+}
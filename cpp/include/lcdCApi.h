@@ -0,0 +1,96 @@
+/*
+# -----------------------------------------------------------------
+# simple_lcd - a command line tools to print message using Hitachi  
+#              HD44780 LCDs connected over I2C on Linux.                   
+# Copyright (C) 2020  Gabriele Bonacini
+#
+# This program is free software for no profit use; you can redistribute
+# it and/or modify it under the terms of the GNU General Public License
+# as published by the Free Software Foundation; either version 2 of
+# the License, or (at your option) any later version.
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+# You should have received a copy of the GNU General Public License
+# along with this program; if not, write to the Free Software Foundation,
+# Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301  USA
+# -----------------------------------------------------------------
+*/
+
+/* C entry points of libslcdpp, for front ends that can not link C++: the
+   Python, Go and Rust ports reach the coalescing, paced C++ engine through
+   ctypes, cgo or an extern block instead of driving the bus themselves.
+
+   An slcd_t owns a driver behind a CoalescingLcdDriver: writes only update
+   the pending screen and a flusher thread sends the changed rows, so callers
+   never sleep on the panel. Calls returning int give 0 on success and -1 on
+   failure, slcd_last_error() then describes the failure. No exception ever
+   crosses this interface. Rows are 1-based, columns 0-based, as in C++. */
+
+#ifndef SLCDPP_CAPI_H
+#define SLCDPP_CAPI_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Bumped on incompatible changes only: fields are appended to slcd_stats_t,
+   never reordered, and slcd_stats() copies no more than the caller asks. */
+#define SLCD_ABI_VERSION 1
+
+typedef struct slcd slcd_t;
+
+typedef struct slcd_stats {
+    uint64_t  bytes;            /* bus bytes, written and read                */
+    uint64_t  syscalls;         /* write()/read()/ioctl() issued              */
+    uint64_t  transactions;     /* bus transactions                           */
+    uint64_t  slept_ns;         /* waiting for instruction deadlines          */
+    uint64_t  bus_ns;           /* inside the transport, syscalls included    */
+    uint64_t  status_reads;     /* busy flag reads                            */
+    uint64_t  retries;
+    uint64_t  errors;           /* failed transactions                        */
+    uint64_t  superseded;       /* writes overwritten before reaching the bus */
+    uint64_t  flushes;          /* flusher passes that sent something         */
+} slcd_stats_t;
+
+int          slcd_abi_version(void);
+
+/* backend: "auto", "i2c-dev", "rdwr", "smbus", "smbus-byte", "trace" or
+   "mock", NULL means "auto". timing: "datasheet", "conservative" or a
+   profile file, NULL keeps the driver default. fps: 0 means 20. Returns
+   NULL on failure. The display is not initialised: call slcd_init(). */
+slcd_t*      slcd_open(const char* device, int addr, unsigned int rows,
+                       unsigned int cols, const char* backend,
+                       const char* timing, unsigned int fps);
+void         slcd_close(slcd_t* lcd);
+
+int          slcd_init(slcd_t* lcd);
+int          slcd_write_line(slcd_t* lcd, const char* text, unsigned int row,
+                             int clean);
+int          slcd_write_at(slcd_t* lcd, const char* text, unsigned int row,
+                           unsigned int col);
+/* count rows, from the first one; missing rows are left unchanged. */
+int          slcd_write_frame(slcd_t* lcd, const char* const* lines,
+                              size_t count);
+/* Blocks until every accepted write reached the panel, reports bus errors
+   raised by the flusher meanwhile. */
+int          slcd_flush(slcd_t* lcd);
+int          slcd_set_fps(slcd_t* lcd, unsigned int fps);
+
+/* Copies min(size, sizeof(slcd_stats_t)) bytes, pass sizeof(*out). */
+int          slcd_stats(const slcd_t* lcd, slcd_stats_t* out, size_t size);
+int          slcd_reset_stats(slcd_t* lcd);
+
+/* Last failure on lcd, or of the calling thread's last slcd_open() when lcd
+   is NULL. Valid until the next call on the same handle. */
+const char*  slcd_last_error(const slcd_t* lcd);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* SLCDPP_CAPI_H */
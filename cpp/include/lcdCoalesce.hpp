@@ -0,0 +1,85 @@
+/*
+# -----------------------------------------------------------------
+# simple_lcd - a command line tools to print message using Hitachi  
+#              HD44780 LCDs connected over I2C on Linux.                   
+# Copyright (C) 2020  Gabriele Bonacini
+#
+# This program is free software for no profit use; you can redistribute
+# it and/or modify it under the terms of the GNU General Public License
+# as published by the Free Software Foundation; either version 2 of
+# the License, or (at your option) any later version.
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+# You should have received a copy of the GNU General Public License
+# along with this program; if not, write to the Free Software Foundation,
+# Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301  USA
+# -----------------------------------------------------------------
+*/
+
+#pragma once
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+#include <exception>
+#include <cstdint>
+
+#include <lcd.hpp>
+
+namespace lcd_hitachi_driver {
+
+    // Latest-wins front end of an LcdDriver for producers faster than the
+    // panel. Writes only update a pending copy of the screen; a flusher thread
+    // sends the rows changed since the last flush at most fps times a second,
+    // so versions overwritten in between never reach the bus.
+    class CoalescingLcdDriver {
+        public:
+            CoalescingLcdDriver(std::unique_ptr<LcdDriver> drv,
+                                unsigned int fps=20)                          anyexcept;
+            ~CoalescingLcdDriver(void)                                        noexcept;
+            CoalescingLcdDriver(const CoalescingLcdDriver&)                   = delete;
+            CoalescingLcdDriver& operator=(const CoalescingLcdDriver&)        = delete;
+
+            void      init(void)                                              anyexcept;
+            void      writeLine(const std::string& msg, unsigned int row, bool clean)
+                                                                              anyexcept;
+            void      writeAt(const std::string& msg, unsigned int row, unsigned int col)
+                                                                              anyexcept;
+            void      writeFrame(const std::vector<std::string>& frame)       anyexcept;
+            void      flush(void)                                             anyexcept;
+            void      setFps(unsigned int fps)                                anyexcept;
+
+            uint64_t  getSuperseded(void)                                     const noexcept;
+            uint64_t  getFlushes(void)                                        const noexcept;
+
+        private:
+            using Clock = std::chrono::steady_clock;
+
+            std::unique_ptr<LcdDriver>   driver;
+            Clock::duration              period;
+            std::vector<std::string>     target;           // screen as last requested
+            std::vector<unsigned char>   dirty;            // rows changed since last flush
+            bool                         pendingInit,
+                                         stopping,
+                                         flushRequest;
+            uint64_t                     requested,        // writes accepted
+                                         taken,            // writes in the last snapshot
+                                         applied,          // writes that reached the bus
+                                         superseded,
+                                         flushes;
+            mutable std::mutex           lock;
+            std::condition_variable      wake,
+                                         done;
+            std::exception_ptr           busError;
+            std::thread                  flusher;
+
+            void  touch(size_t row)                                           noexcept;
+            void  run(void)                                                   noexcept;
+    };
+}
@@ -0,0 +1,98 @@
+/*
+# -----------------------------------------------------------------
+# simple_lcd - a command line tools to print message using Hitachi  
+#              HD44780 LCDs connected over I2C on Linux.                   
+# Copyright (C) 2020  Gabriele Bonacini
+#
+# This program is free software for no profit use; you can redistribute
+# it and/or modify it under the terms of the GNU General Public License
+# as published by the Free Software Foundation; either version 2 of
+# the License, or (at your option) any later version.
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+# You should have received a copy of the GNU General Public License
+# along with this program; if not, write to the Free Software Foundation,
+# Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301  USA
+# -----------------------------------------------------------------
+*/
+
+#pragma once
+
+#include <string_view>
+#include <stdexcept>
+#include <cstddef>
+
+#include <lcdTiming.hpp>
+#include <lcdEncode.hpp>
+
+namespace lcd_hitachi_driver {
+
+    namespace diff {
+
+        // Bus bytes spent to move the cursor and to rewrite one unchanged cell:
+        // a gap of clean cells is bridged when rewriting it is not dearer.
+        static constexpr size_t  REPOSITION_COST { encoding::SEQ_SIZE };
+        static constexpr size_t  CELL_COST       { encoding::SEQ_SIZE };
+
+        // One display copy kept by a driver: rows x columns cells, their
+        // validity (0: content unknown, must be written) and the DDRAM address
+        // command of each row.
+        struct Shadow {
+            char*                 cells;
+            unsigned char*        valid;
+            const unsigned char*  addrs;
+            size_t                rows,
+                                  columns;
+        };
+
+        // Brings row (1-based) of the shadow copy to msg, padded with spaces
+        // when clean, and hands every run of cells to send to the panel to
+        // emit(addrCmd, data, len). Only the cells differing from the copy are
+        // sent; a gap of unchanged cells between two runs is rewritten when
+        // that doesn't cost more bus bytes than a new address command.
+        template<typename Emit>
+        void updateRow(const Shadow& screen, std::string_view msg, size_t row, bool clean, Emit&& emit)
+                                                                              anyexcept{
+            if(row < 1 || row > screen.rows)
+                throw std::runtime_error("writeLine: invalid row number.");
+
+            const size_t    columns { screen.columns },
+                            len     { msg.size() < columns ? msg.size() : columns },
+                            width   { clean ? columns : len };
+            char*           cells   { screen.cells + (row - 1) * columns };
+            unsigned char*  valid   { screen.valid + (row - 1) * columns };
+            size_t          col     { 0 };
+
+            auto target = [&](size_t pos){ return pos < len ? msg[pos] : ' '; };
+            auto dirty  = [&](size_t pos){ return valid[pos] == 0 || cells[pos] != target(pos); };
+
+            while(col < width){
+                if(!dirty(col)){
+                    ++col;
+                    continue;
+                }
+
+                size_t from { col },
+                       end  { col };
+                while(true){
+                    cells[end] = target(end);
+                    valid[end] = 1;
+                    ++end;
+
+                    size_t next { end };
+                    while(next < width && !dirty(next))
+                        ++next;
+                    if(next == width || (next - end) * CELL_COST > REPOSITION_COST){
+                        col = next;
+                        break;
+                    }
+                    end = next;
+                }
+
+                emit(static_cast<unsigned char>(screen.addrs[row - 1] + from), cells + from, end - from);
+            }
+        }
+    }
+}
@@ -0,0 +1,115 @@
+/*
+# -----------------------------------------------------------------
+# simple_lcd - a command line tools to print message using Hitachi  
+#              HD44780 LCDs connected over I2C on Linux.                   
+# Copyright (C) 2020  Gabriele Bonacini
+#
+# This program is free software for no profit use; you can redistribute
+# it and/or modify it under the terms of the GNU General Public License
+# as published by the Free Software Foundation; either version 2 of
+# the License, or (at your option) any later version.
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+# You should have received a copy of the GNU General Public License
+# along with this program; if not, write to the Free Software Foundation,
+# Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301  USA
+# -----------------------------------------------------------------
+*/
+
+#pragma once
+
+#include <string>
+#include <vector>
+#include <array>
+#include <iostream>
+#include <cstdint>
+
+#include <lcdTiming.hpp>
+#include <lcdTransport.hpp>
+
+namespace lcd_hitachi_driver {
+
+    // Software model of a PCF8574 backpack driving an HD44780: it decodes the
+    // byte stream LcdDriver puts on the bus (nibbles latched on EN falling
+    // edges, RS, 8/4 bit modes, DDRAM address map, entry mode) and checks that
+    // every instruction arrives after the previous one has completed. Read
+    // cycles (R/W high) return the busy flag and the address counter.
+    //
+    // As a Transport it can replace the real bus: like a blocking i2c-dev
+    // write(), send() returns when the modelled transfer is over. feed() accepts
+    // recorded transactions and replay() a file written by TraceTransport.
+    // Byte times inside a transaction are derived from busHz: nine clocks per
+    // byte, the address byte included; a transaction can't start before the
+    // previous one has left the bus. Power-on delay is not checked.
+    class Hd44780Emulator : public Transport {
+        public:
+            struct Violation {
+                uint64_t       ns;            // EN falling edge of the early instruction
+                unsigned char  instr;
+                bool           rs;
+                unsigned long  requiredNs,
+                               elapsedNs;
+            };
+
+            Hd44780Emulator(size_t rws=4, size_t cols=16,
+                            const TimingProfile& prof=TimingProfile::datasheet(),
+                            unsigned long busHz=100000)                       anyexcept;
+
+            void  send(const unsigned char* data, size_t len)                 anyexcept override;
+            bool  canRead(void)                                               const noexcept override;
+            void  sendRecv(const unsigned char* out, size_t outLen,
+                           unsigned char* in, size_t inLen)                   anyexcept override;
+            void  feed(const unsigned char* data, size_t len, uint64_t ns)    noexcept;
+            void  replay(const std::string& tracePath)                        anyexcept;
+
+            std::vector<std::string>        getScreen(void)                   const noexcept;
+            const std::vector<Violation>&   getViolations(void)               const noexcept;
+            bool                            isFourBit(void)                   const noexcept;
+            bool                            isDisplayOn(void)                 const noexcept;
+            unsigned char                   getAddressCounter(void)           const noexcept;
+            void                            report(std::ostream& out)         const noexcept;
+
+        private:
+            static const size_t         DDRAM_SIZE      { 0x80 };
+            static const size_t         CGRAM_SIZE      { 0x40 };
+            static const size_t         LINE_CELLS      { 40 };
+            static const unsigned char  EN              { 0x4 };
+            static const unsigned char  RS              { 0x1 };
+            static const unsigned char  RW              { 0x2 };
+            static const unsigned long  BYTE_CLOCKS     { 9 };
+
+            size_t                                rows,
+                                                  columns;
+            TimingProfile                         timing;
+            unsigned long                         busHz;
+            std::array<char, DDRAM_SIZE>          ddram;
+            std::array<unsigned char, CGRAM_SIZE> cgram;
+            std::vector<Violation>                violations;
+            unsigned char                         lastByte,
+                                                  highNibble,
+                                                  addrCounter,
+                                                  displayShift;     // cells the window moved left
+            bool                                  fourBit,
+                                                  twoLines,
+                                                  pendingHigh,
+                                                  readLow,
+                                                  increment,
+                                                  displayOn,
+                                                  cgramMode;
+            unsigned int                          functionSets8;
+            uint64_t                              busFree,          // end of the last transaction
+                                                  busyUntil,        // previous instruction completes
+                                                  execStart,        // previous instruction latched
+                                                  firstEdge;        // first nibble of the current one
+
+            void           waitBus(void)                                      const noexcept;
+            void           latch(unsigned char nibble, bool rs, uint64_t ns)  noexcept;
+            void           execute(unsigned char instr, bool rs, uint64_t ns) noexcept;
+            void           writeData(unsigned char data)                      noexcept;
+            void           stepCounter(bool forward)                          noexcept;
+            unsigned long  busyTime(unsigned char instr, bool rs)             noexcept;
+            unsigned char  rowBase(size_t row)                                const noexcept;
+    };
+}
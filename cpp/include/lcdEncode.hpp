@@ -0,0 +1,66 @@
+/*
+# -----------------------------------------------------------------
+# simple_lcd - a command line tools to print message using Hitachi  
+#              HD44780 LCDs connected over I2C on Linux.                   
+# Copyright (C) 2020  Gabriele Bonacini
+#
+# This program is free software for no profit use; you can redistribute
+# it and/or modify it under the terms of the GNU General Public License
+# as published by the Free Software Foundation; either version 2 of
+# the License, or (at your option) any later version.
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+# You should have received a copy of the GNU General Public License
+# along with this program; if not, write to the Free Software Foundation,
+# Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301  USA
+# -----------------------------------------------------------------
+*/
+
+#pragma once
+
+#include <string_view>
+#include <array>
+#include <cstddef>
+
+namespace lcd_hitachi_driver {
+
+    // PCF8574 expansion of HD44780 bytes. Every byte travels as two nibbles,
+    // each one put on D7-D4 three times: EN low, EN high, EN low; the falling
+    // edge latches it. RS is bit 0, the backlight bit 3.
+    namespace encoding {
+
+        const size_t         SEQ_SIZE       { 6 };
+        const unsigned char  LCD_BACKLIGHT  { 0x08 };
+        const unsigned char  EN             { 0x04 };
+        const unsigned char  MODE_RS        { 0x01 };
+
+        using Sequence = std::array<unsigned char, SEQ_SIZE>;
+        using Table    = std::array<std::array<Sequence, 256>, 2>;
+
+        constexpr Sequence expand(unsigned char cmd, unsigned char mode) noexcept{
+            unsigned char first  { static_cast<unsigned char>(mode | ( cmd & 0xF0 ) | LCD_BACKLIGHT) };
+            unsigned char second { static_cast<unsigned char>(mode | ( (cmd << 4 ) & 0xF0 ) | LCD_BACKLIGHT) };
+            return {{ first,  static_cast<unsigned char>(first | EN),  first,
+                      second, static_cast<unsigned char>(second | EN), second }};
+        }
+
+        constexpr Table makeTable(void) noexcept{
+            Table table {};
+            for(size_t mode { 0 }; mode < 2; ++mode)
+                for(size_t cmd { 0 }; cmd < 256; ++cmd)
+                    table[mode][cmd] = expand(static_cast<unsigned char>(cmd), static_cast<unsigned char>(mode));
+            return table;
+        }
+
+        // [0]: instructions (RS=0), [1]: data (RS=1).
+        inline constexpr Table TABLE { makeTable() };
+
+        // Writes SEQ_SIZE * text.size() bytes to out: text as DDRAM data, or as
+        // instructions when mode is 0. Returns the number of bytes written.
+        size_t       encodeLine(std::string_view text, unsigned char* out,
+                                unsigned char mode=MODE_RS)                   noexcept;
+        const char*  encoderName(void)                                        noexcept;
+    }
+}
@@ -0,0 +1,233 @@
+/*
+# -----------------------------------------------------------------
+# simple_lcd - a command line tools to print message using Hitachi  
+#              HD44780 LCDs connected over I2C on Linux.                   
+# Copyright (C) 2020  Gabriele Bonacini
+#
+# This program is free software for no profit use; you can redistribute
+# it and/or modify it under the terms of the GNU General Public License
+# as published by the Free Software Foundation; either version 2 of
+# the License, or (at your option) any later version.
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+# You should have received a copy of the GNU General Public License
+# along with this program; if not, write to the Free Software Foundation,
+# Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301  USA
+# -----------------------------------------------------------------
+*/
+
+#pragma once
+
+#include <string>
+#include <string_view>
+#include <array>
+#include <memory>
+#include <stdexcept>
+
+#include <lcdTiming.hpp>
+#include <lcdTransport.hpp>
+#include <lcdEncode.hpp>
+#include <lcdDiff.hpp>
+
+namespace lcd_hitachi_driver {
+
+    // LcdDriver with the geometry fixed at compile time: DDRAM row addresses,
+    // the init byte stream and every buffer are constants, so updates run
+    // without geometry branches and without touching the heap. The runtime
+    // LcdDriver stays for the command line tools.
+    template<size_t ROWS, size_t COLS>
+    class FixedLcdDriver {
+        static_assert(ROWS == 1 || ROWS == 2 || ROWS == 4, "Max row number not supported.");
+        static_assert(COLS >= 8 && COLS <= 40, "Column number not supported.");
+        // Rows 3 and 4 continue rows 1 and 2 in the 40 cells of each DDRAM line.
+        static_assert(ROWS != 4 || COLS <= 20, "A 4 rows display has at most 20 columns.");
+
+        public:
+            static constexpr size_t         OUTPUT_BUFF_SIZE { encoding::SEQ_SIZE };
+            static constexpr size_t         INIT_ROWS        { 10 };
+
+            using Frame    = std::array<std::string_view, ROWS>;
+
+            explicit FixedLcdDriver(std::unique_ptr<Transport> tr)            anyexcept;
+            FixedLcdDriver(const FixedLcdDriver&)                             = delete;
+            FixedLcdDriver& operator=(const FixedLcdDriver&)                  = delete;
+
+            void init(void)                                                   anyexcept;
+            template<size_t ROW>
+            void writeLine(std::string_view msg, bool clean)                  anyexcept;
+            void writeLine(std::string_view msg, unsigned int row, bool clean) anyexcept;
+            void writeFrame(const Frame& frame)                               anyexcept;
+            void invalidate(void)                                             noexcept;
+            void setTiming(const TimingProfile& prof)                         noexcept;
+            const TimingProfile& getTiming(void)                              const noexcept;
+
+            static constexpr std::array<unsigned char, ROWS> rowAddresses(void) noexcept{
+                constexpr unsigned char base[] { 0x80, 0xC0,
+                                                 static_cast<unsigned char>(0x80 + COLS),
+                                                 static_cast<unsigned char>(0xC0 + COLS) };
+                std::array<unsigned char, ROWS> addrs {};
+                for(size_t idx { 0 }; idx < ROWS; ++idx)
+                    addrs[idx] = base[idx];
+                return addrs;
+            }
+
+            static constexpr std::array<unsigned char, INIT_ROWS * OUTPUT_BUFF_SIZE> initBytes(void) noexcept{
+                // 8 bit function set three times, switch to 4 bit, 2 lines 5x8,
+                // display on, clear, entry mode increment, clear, home.
+                constexpr unsigned char cmds[INIT_ROWS] { 0x03, 0x03, 0x03, 0x02, 0x28,
+                                                          0x0C, 0x01, 0x06, 0x01, 0x02 };
+                std::array<unsigned char, INIT_ROWS * OUTPUT_BUFF_SIZE> seq {};
+                for(size_t idx { 0 }; idx < INIT_ROWS; ++idx){
+                    encoding::Sequence enc { encoding::expand(cmds[idx], 0) };
+                    for(size_t pos { 0 }; pos < OUTPUT_BUFF_SIZE; ++pos)
+                        seq[idx * OUTPUT_BUFF_SIZE + pos] = enc[pos];
+                }
+                return seq;
+            }
+
+            static constexpr std::array<unsigned char, ROWS>  ROW_ADDRS  { rowAddresses() };
+            static constexpr std::array<unsigned char, INIT_ROWS * OUTPUT_BUFF_SIZE>
+                                                              INIT_BYTES { initBytes() };
+
+        private:
+            // Worst case per row: every cell plus an address command every
+            // third cell, since a single clean cell is always bridged.
+            static constexpr size_t         MAX_CMDS         { ROWS * (COLS + COLS / 3 + 1) };
+
+            static constexpr std::array<Delay, INIT_ROWS> INIT_DELAYS {{
+                Delay::INIT_LONG,  Delay::INIT_SHORT, Delay::EXEC, Delay::EXEC,
+                Delay::EXEC,       Delay::EXEC,       Delay::CLEAR_HOME,
+                Delay::EXEC,       Delay::CLEAR_HOME, Delay::CLEAR_HOME
+            }};
+
+            struct TxMark {
+                size_t  end;
+                Delay   delay;
+            };
+
+            std::unique_ptr<Transport>                              bus;
+            TimingProfile                                           timing;
+            Pacer                                                   pacer;
+            std::array<unsigned char, MAX_CMDS * OUTPUT_BUFF_SIZE>  txBuff;
+            std::array<TxMark, MAX_CMDS>                            txMarks;
+            size_t                                                  txLen,
+                                                                    marks;
+            std::array<char, ROWS * COLS>                           shadow;
+            std::array<unsigned char, ROWS * COLS>                  shadowValid;
+
+            void queueRow(std::string_view msg, size_t row, bool clean)       anyexcept;
+            void queueCmd(unsigned char cmd, Delay dl)                        noexcept;
+            void queueData(const char* data, size_t len)                      noexcept;
+            void sendBuffer(void)                                             anyexcept;
+    };
+
+    template<size_t ROWS, size_t COLS>
+    FixedLcdDriver<ROWS, COLS>::FixedLcdDriver(std::unique_ptr<Transport> tr) anyexcept
+      : bus{std::move(tr)}, timing{TimingProfile::conservative()}, txLen{0}, marks{0}
+    {
+        if(!bus)
+            throw std::runtime_error("FixedLcdDriver: no transport.");
+        shadow.fill(' ');
+        shadowValid.fill(0);
+    }
+
+    template<size_t ROWS, size_t COLS>
+    void FixedLcdDriver<ROWS, COLS>::init(void) anyexcept{
+        pacer.arm(timing.delay(Delay::POWER_ON));
+        for(size_t idx { 0 }; idx < INIT_ROWS; ++idx){
+            for(size_t pos { 0 }; pos < OUTPUT_BUFF_SIZE; ++pos)
+                txBuff[txLen++] = INIT_BYTES[idx * OUTPUT_BUFF_SIZE + pos];
+            txMarks[marks++] = { txLen, INIT_DELAYS[idx] };
+        }
+        sendBuffer();
+
+        shadow.fill(' ');
+        shadowValid.fill(1);
+    }
+
+    template<size_t ROWS, size_t COLS>
+    template<size_t ROW>
+    void FixedLcdDriver<ROWS, COLS>::writeLine(std::string_view msg, bool clean) anyexcept{
+        static_assert(ROW >= 1 && ROW <= ROWS, "Invalid row number.");
+        queueRow(msg, ROW, clean);
+        sendBuffer();
+    }
+
+    template<size_t ROWS, size_t COLS>
+    void FixedLcdDriver<ROWS, COLS>::writeLine(std::string_view msg, unsigned int row, bool clean) anyexcept{
+        queueRow(msg, row, clean);
+        sendBuffer();
+    }
+
+    template<size_t ROWS, size_t COLS>
+    void FixedLcdDriver<ROWS, COLS>::writeFrame(const Frame& frame) anyexcept{
+        for(size_t idx { 0 }; idx < ROWS; ++idx)
+            queueRow(frame[idx], idx + 1, true);
+        sendBuffer();
+    }
+
+    template<size_t ROWS, size_t COLS>
+    void FixedLcdDriver<ROWS, COLS>::invalidate(void) noexcept{
+        shadowValid.fill(0);
+    }
+
+    template<size_t ROWS, size_t COLS>
+    void FixedLcdDriver<ROWS, COLS>::setTiming(const TimingProfile& prof) noexcept{
+        timing = prof;
+    }
+
+    template<size_t ROWS, size_t COLS>
+    const TimingProfile& FixedLcdDriver<ROWS, COLS>::getTiming(void) const noexcept{
+        return timing;
+    }
+
+    template<size_t ROWS, size_t COLS>
+    void FixedLcdDriver<ROWS, COLS>::queueRow(std::string_view msg, size_t row, bool clean) anyexcept{
+        const diff::Shadow screen { shadow.data(), shadowValid.data(), ROW_ADDRS.data(), ROWS, COLS };
+        diff::updateRow(screen, msg, row, clean, [this](unsigned char cmd, const char* data, size_t len){
+            queueCmd(cmd, Delay::EXEC);
+            queueData(data, len);
+        });
+    }
+
+    template<size_t ROWS, size_t COLS>
+    void FixedLcdDriver<ROWS, COLS>::queueCmd(unsigned char cmd, Delay dl) noexcept{
+        const encoding::Sequence& seq { encoding::TABLE[0][cmd] };
+        for(size_t pos { 0 }; pos < OUTPUT_BUFF_SIZE; ++pos)
+            txBuff[txLen++] = seq[pos];
+        txMarks[marks++] = { txLen, dl };
+    }
+
+    template<size_t ROWS, size_t COLS>
+    void FixedLcdDriver<ROWS, COLS>::queueData(const char* data, size_t len) noexcept{
+        size_t start { txLen };
+        txLen += encoding::encodeLine(std::string_view(data, len), txBuff.data() + start);
+        for(size_t idx { 1 }; idx <= len; ++idx)
+            txMarks[marks++] = { start + idx * OUTPUT_BUFF_SIZE, Delay::DATA };
+    }
+
+    template<size_t ROWS, size_t COLS>
+    void FixedLcdDriver<ROWS, COLS>::sendBuffer(void) anyexcept{
+        const unsigned long slack { timing.chainSlackNs() };
+        size_t              start { 0 };
+        try{
+            for(size_t idx { 0 }; idx < marks; ++idx){
+                unsigned long wait { timing.delay(txMarks[idx].delay) };
+                if(wait <= slack && idx + 1 < marks)
+                    continue;
+
+                pacer.waitReady();
+                bus->send(txBuff.data() + start, txMarks[idx].end - start);
+                pacer.arm(wait);
+                start = txMarks[idx].end;
+            }
+        } catch (...) {
+            txLen = marks = 0;
+            invalidate();
+            throw;
+        }
+        txLen = marks = 0;
+    }
+}
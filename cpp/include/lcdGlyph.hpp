@@ -0,0 +1,74 @@
+/*
+# -----------------------------------------------------------------
+# simple_lcd - a command line tools to print message using Hitachi  
+#              HD44780 LCDs connected over I2C on Linux.                   
+# Copyright (C) 2020  Gabriele Bonacini
+#
+# This program is free software for no profit use; you can redistribute
+# it and/or modify it under the terms of the GNU General Public License
+# as published by the Free Software Foundation; either version 2 of
+# the License, or (at your option) any later version.
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+# You should have received a copy of the GNU General Public License
+# along with this program; if not, write to the Free Software Foundation,
+# Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301  USA
+# -----------------------------------------------------------------
+*/
+
+#pragma once
+
+#include <string>
+#include <vector>
+#include <array>
+#include <unordered_map>
+
+#include <lcd.hpp>
+
+namespace lcd_hitachi_driver {
+
+    // Maps named glyphs to the eight CGRAM slots. A glyph is uploaded only when
+    // it isn't resident, evicting the least recently used one; references are
+    // plain characters in the strings given to writeLine()/writeFrame(), so in
+    // steady state a widget costs data writes only.
+    //
+    // Codes 0x08-0x0F are used: they mirror 0x00-0x07 and keep NUL out of the
+    // strings. Evicting a glyph changes the cells still showing it: a screen
+    // should not reference more than eight distinct glyphs at once.
+    class GlyphCache {
+        public:
+            using Glyph = LcdDriver::Glyph;
+
+            static const size_t         BAR_STEPS      { 5 };   // pixel columns per cell
+            static const size_t         LEVEL_STEPS    { 8 };   // pixel rows per cell
+
+            explicit GlyphCache(const LcdDriver& drv)                         anyexcept;
+
+            void         define(const std::string& name, const Glyph& glyph)  anyexcept;
+            char         glyph(const std::string& name)                       anyexcept;
+            std::string  bar(double fraction, size_t width)                   anyexcept;
+            std::string  sparkline(const std::vector<double>& values,
+                                   double low, double high)                   anyexcept;
+            void         invalidate(void)                                     noexcept;
+            size_t       getUploads(void)                                     const noexcept;
+
+        private:
+            static const unsigned char  CODE_BASE      { 0x08 };
+            static const char           FULL_BLOCK     { static_cast<char>(0xFF) };
+
+            struct Slot {
+                std::string    name;
+                unsigned long  lastUse;
+            };
+
+            const LcdDriver&                                  driver;
+            std::unordered_map<std::string, Glyph>            glyphs;
+            std::array<Slot, LcdDriver::CGRAM_SLOTS>          slots;
+            unsigned long                                     tick;
+            size_t                                            uploads;
+
+            void  upload(size_t slot, const std::string& name)                anyexcept;
+    };
+}
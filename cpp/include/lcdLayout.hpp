@@ -0,0 +1,88 @@
+/*
+# -----------------------------------------------------------------
+# simple_lcd - a command line tools to print message using Hitachi  
+#              HD44780 LCDs connected over I2C on Linux.                   
+# Copyright (C) 2020  Gabriele Bonacini
+#
+# This program is free software for no profit use; you can redistribute
+# it and/or modify it under the terms of the GNU General Public License
+# as published by the Free Software Foundation; either version 2 of
+# the License, or (at your option) any later version.
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+# You should have received a copy of the GNU General Public License
+# along with this program; if not, write to the Free Software Foundation,
+# Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301  USA
+# -----------------------------------------------------------------
+*/
+
+#pragma once
+
+#include <string>
+#include <vector>
+#include <functional>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+
+#include <lcd.hpp>
+
+namespace lcd_hitachi_driver {
+
+    // Screen compositor: rectangular regions, each one row high and width cells
+    // wide, fed by a producer called every interval or by set(). A tick runs
+    // the producers that are due, composes the regions into one frame and
+    // hands it to the driver, whose shadow diff sends only what changed: a
+    // fast widget never redraws a slow one, a tick costs one writeFrame().
+    //
+    // Regions are added before ticking starts; set() may be called from any
+    // thread. Rows start from 1, columns from 0, as in
+    // CoalescingLcdDriver::writeAt().
+    class Layout {
+        public:
+            using Clock     = std::chrono::steady_clock;
+            using Producer  = std::function<std::string(void)>;
+
+            enum class Align { LEFT, RIGHT };
+
+            explicit Layout(const LcdDriver& drv)                             noexcept;
+            Layout(const Layout&)                                             = delete;
+            Layout& operator=(const Layout&)                                  = delete;
+
+            size_t             addRegion(unsigned int row, unsigned int col, size_t width,
+                                         Producer prod=nullptr,
+                                         Clock::duration interval=std::chrono::seconds(1),
+                                         Align align=Align::LEFT)             anyexcept;
+            void               set(size_t region, const std::string& text)    anyexcept;
+            bool               tick(void)                                     anyexcept;
+            void               run(const std::atomic<bool>& stop)             anyexcept;
+            Clock::time_point  nextDue(void)                                  const noexcept;
+            uint64_t           getFrames(void)                                const noexcept;
+
+        private:
+            struct Region {
+                unsigned int       row,
+                                   col;
+                size_t             width;
+                Producer           producer;
+                Clock::duration    interval;
+                Clock::time_point  due;
+                Align              align;
+                std::string        text;
+            };
+
+            const LcdDriver&             driver;
+            std::vector<Region>          regions;
+            std::vector<std::string>     screen;
+            bool                         changed;          // a region got new text since the last frame
+            std::atomic<uint64_t>        frames;           // read by getFrames() from any thread
+            mutable std::mutex           lock;
+            std::condition_variable      wake;
+
+            std::string  fit(const Region& reg, const std::string& text)      const;
+    };
+}
@@ -0,0 +1,101 @@
+/*
+# -----------------------------------------------------------------
+# simple_lcd - a command line tools to print message using Hitachi  
+#              HD44780 LCDs connected over I2C on Linux.                   
+# Copyright (C) 2020  Gabriele Bonacini
+#
+# This program is free software for no profit use; you can redistribute
+# it and/or modify it under the terms of the GNU General Public License
+# as published by the Free Software Foundation; either version 2 of
+# the License, or (at your option) any later version.
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+# You should have received a copy of the GNU General Public License
+# along with this program; if not, write to the Free Software Foundation,
+# Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301  USA
+# -----------------------------------------------------------------
+*/
+
+#pragma once
+
+#include <string>
+#include <vector>
+#include <map>
+#include <memory>
+#include <exception>
+#include <cstdint>
+
+#include <lcd.hpp>
+#include <lcdAsync.hpp>
+
+namespace lcd_hitachi_driver {
+
+    // Drives many panels spread over several I2C adapters. Panels sharing an
+    // adapter are served in order by that adapter's worker thread, distinct
+    // adapters work in parallel. Panels are registered with addPanel() before
+    // start(); updates are routed by panel id and don't wait for the bus.
+    class DisplayManager {
+        public:
+            explicit DisplayManager(size_t queueDepth=64)                     noexcept;
+            ~DisplayManager(void)                                             noexcept;
+            DisplayManager(const DisplayManager&)                             = delete;
+            DisplayManager& operator=(const DisplayManager&)                  = delete;
+
+            void    addPanel(const std::string& id, const std::string& dev, int addr,
+                             size_t rws=4, size_t cols=16,
+                             const std::string& backend="auto",
+                             const TimingProfile& prof=TimingProfile::conservative())
+                                                                              anyexcept;
+            void    addPanel(const std::string& id, const std::string& bus,
+                             std::unique_ptr<LcdDriver> drv)                  anyexcept;
+            void    start(void)                                               anyexcept;
+
+            void    init(const std::string& id)                               anyexcept;
+            void    initAll(void)                                             anyexcept;
+            void    writeLine(const std::string& id, std::string msg,
+                              unsigned int row, bool clean)                   anyexcept;
+            void    writeFrame(const std::string& id,
+                               const std::vector<std::string>& frame)         anyexcept;
+            void    flush(void)                                               anyexcept;
+
+            size_t  getBuses(void)                                            const noexcept;
+            size_t  getPanels(void)                                           const noexcept;
+
+        private:
+            enum class JobType : unsigned char { INIT, LINE, FRAME };
+
+            struct Job {
+                JobType                   type;
+                LcdDriver*                driver;
+                unsigned int              row;
+                bool                      clean;
+                std::vector<std::string>  text;
+                uint64_t                  weight;
+            };
+
+            // An adapter: its panels and the worker serving them in order.
+            struct Bus {
+                Bus(const std::string& dev, size_t queueDepth)                anyexcept;
+
+                std::string                              device;
+                std::vector<std::unique_ptr<LcdDriver>>  drivers;
+                BusWorker<Job>                           worker;
+            };
+
+            struct Panel {
+                Bus*        bus;
+                LcdDriver*  driver;
+            };
+
+            size_t                                             depth;
+            bool                                               started;
+            std::vector<std::unique_ptr<Bus>>                  buses;
+            std::map<std::string, Panel>                       panels;
+
+            const Panel&  route(const std::string& id)                        const anyexcept;
+            void          submit(const Panel& pnl, Job& job)                  anyexcept;
+            static void   apply(Job& job)                                     anyexcept;
+    };
+}
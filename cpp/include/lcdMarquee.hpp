@@ -0,0 +1,56 @@
+/*
+# -----------------------------------------------------------------
+# simple_lcd - a command line tools to print message using Hitachi  
+#              HD44780 LCDs connected over I2C on Linux.                   
+# Copyright (C) 2020  Gabriele Bonacini
+#
+# This program is free software for no profit use; you can redistribute
+# it and/or modify it under the terms of the GNU General Public License
+# as published by the Free Software Foundation; either version 2 of
+# the License, or (at your option) any later version.
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+# You should have received a copy of the GNU General Public License
+# along with this program; if not, write to the Free Software Foundation,
+# Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301  USA
+# -----------------------------------------------------------------
+*/
+
+#pragma once
+
+#include <string>
+
+#include <lcd.hpp>
+
+namespace lcd_hitachi_driver {
+
+    // Scrolling by display shift. Each DDRAM line holds 40 cells and the
+    // visible window slides over it: the text is written once and every step
+    // is a single cursor/display shift instruction instead of a row rewrite.
+    //
+    // The shift moves both lines, hence every row, at once. On 4 row panels
+    // rows 3 and 4 are the continuation of rows 1 and 2 in the same DDRAM line,
+    // so they show the next part of the same text. Call home() before going
+    // back to LcdDriver::writeLine(), which assumes an unshifted display.
+    class Marquee {
+        public:
+            static const size_t         LINE_CELLS   { 40 };
+
+            explicit Marquee(const LcdDriver& drv)                            noexcept;
+
+            void    load(const std::string& text, unsigned int line=1)        anyexcept;
+            void    step(bool left=true)                                      anyexcept;
+            void    home(void)                                                anyexcept;
+            size_t  getOffset(void)                                           const noexcept;
+
+        private:
+            static const unsigned char  SHIFT_LEFT   { 0x18 };
+            static const unsigned char  SHIFT_RIGHT  { 0x1C };
+            static const unsigned char  RETURN_HOME  { 0x02 };
+
+            const LcdDriver&  driver;
+            size_t            offset;
+    };
+}
@@ -0,0 +1,93 @@
+/*
+# -----------------------------------------------------------------
+# simple_lcd - a command line tools to print message using Hitachi  
+#              HD44780 LCDs connected over I2C on Linux.                   
+# Copyright (C) 2020  Gabriele Bonacini
+#
+# This program is free software for no profit use; you can redistribute
+# it and/or modify it under the terms of the GNU General Public License
+# as published by the Free Software Foundation; either version 2 of
+# the License, or (at your option) any later version.
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+# You should have received a copy of the GNU General Public License
+# along with this program; if not, write to the Free Software Foundation,
+# Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301  USA
+# -----------------------------------------------------------------
+*/
+
+#pragma once
+
+#include <string>
+#include <vector>
+#include <cstdint>
+
+#ifndef anyexcept
+#define  anyexcept noexcept(false)
+#endif
+
+namespace lcd_hitachi_driver {
+
+    // Framing used between simple_lcdd and its clients over a Unix domain
+    // stream socket. Every message is an 8 byte header followed by a payload:
+    //
+    //   0-1  magic 'L' 'C'
+    //   2    protocol version
+    //   3    message type
+    //   4    row (1 based), or status code in a reply
+    //   5    flags
+    //   6-7  payload length, big endian
+    //
+    // Every request is answered with a REPLY carrying the status and, on
+    // failure, the error text as payload.
+    namespace protocol {
+
+        const char* const    DEFAULT_SOCKET   { "/run/simple_lcdd.sock" };
+        const uint8_t        VERSION          { 1 };
+        const size_t         HEADER_SIZE      { 8 };
+        const size_t         MAX_PAYLOAD      { 0xFFFF };
+
+        const uint8_t        FLAG_CLEAN       { 0x01 };
+
+        const uint8_t        STATUS_OK        { 0 };
+        const uint8_t        STATUS_BAD_REQ   { 1 };
+        const uint8_t        STATUS_BUS_ERROR { 2 };
+
+        enum class MsgType : uint8_t {
+            INIT         = 1,
+            WRITE_LINE   = 2,
+            WRITE_FRAME  = 3,     // rows separated by '\n'
+            REPLY        = 0x80
+        };
+
+        struct Message {
+            MsgType      type;
+            uint8_t      row,
+                         flags;
+            std::string  payload;
+        };
+
+        bool  readMessage(int fd, Message& msg)                              anyexcept;
+        void  writeMessage(int fd, const Message& msg)                       anyexcept;
+
+        class LcdClient {
+            public:
+                explicit LcdClient(const std::string& path=DEFAULT_SOCKET)   anyexcept;
+                ~LcdClient(void)                                             noexcept;
+                LcdClient(const LcdClient&)                                  = delete;
+                LcdClient& operator=(const LcdClient&)                       = delete;
+
+                void  init(void)                                             anyexcept;
+                void  writeLine(const std::string& msg, unsigned int row, bool clean)
+                                                                             anyexcept;
+                void  writeFrame(const std::vector<std::string>& frame)      anyexcept;
+
+            private:
+                int   fdSock;
+
+                void  request(const Message& msg)                            anyexcept;
+        };
+    }
+}
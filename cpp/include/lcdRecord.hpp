@@ -0,0 +1,93 @@
+/*
+# -----------------------------------------------------------------
+# simple_lcd - a command line tools to print message using Hitachi  
+#              HD44780 LCDs connected over I2C on Linux.                   
+# Copyright (C) 2020  Gabriele Bonacini
+#
+# This program is free software for no profit use; you can redistribute
+# it and/or modify it under the terms of the GNU General Public License
+# as published by the Free Software Foundation; either version 2 of
+# the License, or (at your option) any later version.
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+# You should have received a copy of the GNU General Public License
+# along with this program; if not, write to the Free Software Foundation,
+# Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301  USA
+# -----------------------------------------------------------------
+*/
+
+#pragma once
+
+#include <string>
+#include <vector>
+#include <fstream>
+#include <cstdint>
+
+#include <lcdTiming.hpp>
+
+namespace lcd_hitachi_driver {
+
+    // Compact binary trace of the bus traffic of one driver. After the "LCDT"
+    // magic and a version byte every transaction is a record:
+    //
+    //   op          API call that produced it, READ_FLAG set for the busy flag
+    //               reads it made
+    //   delay       Delay class the transaction waits for, NO_DELAY for reads
+    //   delta       ns since the previous record (LEB128)
+    //   length      bus bytes (LEB128), then the bytes; for reads the bytes
+    //               written before reading.
+    namespace trace {
+
+        enum class Op : unsigned char {
+            INIT,
+            WRITE_LINE,
+            WRITE_FRAME,
+            COMMAND,
+            WRITE_DDRAM,
+            WRITE_CGRAM
+        };
+
+        const unsigned char  READ_FLAG   { 0x80 };
+        const unsigned char  NO_DELAY    { 0xFF };
+        const unsigned char  VERSION     { 1 };
+
+        struct Event {
+            Op                          op;
+            bool                        read;
+            unsigned char               delay;      // a Delay, or NO_DELAY
+            uint64_t                    ns;         // since the first record
+            std::vector<unsigned char>  bytes;
+        };
+
+        const char*  opName(Op op)                                            noexcept;
+
+        class TraceWriter {
+            public:
+                explicit TraceWriter(const std::string& path)                  anyexcept;
+
+                void  record(Op op, bool read, unsigned char delay,
+                             const unsigned char* data, size_t len)           anyexcept;
+
+            private:
+                std::ofstream  out;
+                uint64_t       last;
+
+                void  putVarint(uint64_t val)                                 anyexcept;
+        };
+
+        class TraceReader {
+            public:
+                explicit TraceReader(const std::string& path)                  anyexcept;
+
+                bool  next(Event& event)                                      anyexcept;
+
+            private:
+                std::ifstream  in;
+                uint64_t       elapsed;
+
+                bool  getVarint(uint64_t& val)                                anyexcept;
+        };
+    }
+}
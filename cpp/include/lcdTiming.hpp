@@ -0,0 +1,73 @@
+/*
+# -----------------------------------------------------------------
+# simple_lcd - a command line tools to print message using Hitachi  
+#              HD44780 LCDs connected over I2C on Linux.                   
+# Copyright (C) 2020  Gabriele Bonacini
+#
+# This program is free software for no profit use; you can redistribute
+# it and/or modify it under the terms of the GNU General Public License
+# as published by the Free Software Foundation; either version 2 of
+# the License, or (at your option) any later version.
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+# You should have received a copy of the GNU General Public License
+# along with this program; if not, write to the Free Software Foundation,
+# Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301  USA
+# -----------------------------------------------------------------
+*/
+
+#pragma once
+
+#include <time.h>
+
+#include <string>
+#include <cstdint>
+
+#ifndef anyexcept
+#define  anyexcept noexcept(false)
+#endif
+
+namespace lcd_hitachi_driver {
+
+    // Execution time classes of the HD44780 instruction set.
+    enum class Delay : unsigned char {
+        EXEC,          // most instructions
+        DATA,          // DDRAM/CGRAM data write (exec + tADD)
+        CLEAR_HOME,    // clear display, return home
+        INIT_LONG,     // after the first 8 bit function set of the init sequence
+        INIT_SHORT,    // after the second 8 bit function set
+        POWER_ON       // from Vcc rise to the first instruction
+    };
+
+    struct TimingProfile {
+        unsigned long  execNs,
+                       dataNs,
+                       clearHomeNs,
+                       initLongNs,
+                       initShortNs,
+                       powerOnNs,
+                       maxBusHz;
+
+        unsigned long         delay(Delay dl)                                 const noexcept;
+        unsigned long         chainSlackNs(void)                              const noexcept;
+
+        static TimingProfile  datasheet(void)                                 noexcept;
+        static TimingProfile  conservative(void)                              noexcept;
+        static TimingProfile  fromFile(const std::string& path)               anyexcept;
+        static TimingProfile  byName(const std::string& name)                 anyexcept;
+    };
+
+    class Pacer {
+        public:
+            Pacer(void)                                                       noexcept;
+            void          arm(unsigned long ns)                               noexcept;
+            void          waitReady(void)                                     noexcept;
+            uint64_t      getSleptNs(void)                                    const noexcept;
+
+        private:
+            struct timespec  deadline;
+            uint64_t         sleptNs;
+    };
+}
@@ -0,0 +1,188 @@
+/*
+# -----------------------------------------------------------------
+# simple_lcd - a command line tools to print message using Hitachi  
+#              HD44780 LCDs connected over I2C on Linux.                   
+# Copyright (C) 2020  Gabriele Bonacini
+#
+# This program is free software for no profit use; you can redistribute
+# it and/or modify it under the terms of the GNU General Public License
+# as published by the Free Software Foundation; either version 2 of
+# the License, or (at your option) any later version.
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+# You should have received a copy of the GNU General Public License
+# along with this program; if not, write to the Free Software Foundation,
+# Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301  USA
+# -----------------------------------------------------------------
+*/
+
+#pragma once
+
+#include <time.h>
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <fstream>
+#include <cstdint>
+#include <atomic>
+#include <stdexcept>
+
+#ifndef anyexcept
+#define  anyexcept noexcept(false)
+#endif
+
+namespace lcd_hitachi_driver {
+
+    // A failed bus transfer. code is the errno of the failing syscall, EIO for
+    // a short transfer; transient() tells errors worth a retry: adapter busy
+    // (EAGAIN), missing ack (EREMOTEIO) or device not responding (ENXIO), the
+    // symptoms of a noisy or loose cable.
+    class BusError : public std::runtime_error {
+        public:
+            BusError(int err, const std::string& msg)                         noexcept;
+
+            int   code(void)                                                  const noexcept;
+            bool  transient(void)                                             const noexcept;
+
+        private:
+            int   errCode;
+    };
+
+    // Byte sink between LcdDriver and the PCF8574 backpack. Every send() is one
+    // bus transaction: the driver already paces consecutive calls. Backends
+    // able to read the port override canRead() and sendRecv(), a write
+    // followed by a read, in a single transaction where the bus allows it.
+    class Transport {
+        public:
+            virtual ~Transport(void)                                          noexcept;
+            virtual void  send(const unsigned char* data, size_t len)         anyexcept = 0;
+            virtual bool  canRead(void)                                       const noexcept;
+            virtual void  sendRecv(const unsigned char* out, size_t outLen,
+                                   unsigned char* in, size_t inLen)           anyexcept;
+            uint64_t      getSyscalls(void)                                   const noexcept;
+
+            // "auto" (default), "i2c-dev", "rdwr", "smbus", "smbus-byte", "trace"
+            // or "mock"; for "trace" dev is the path of the output file. "auto"
+            // reads the adapter's I2C_FUNCS: plain I2C gets "rdwr", SMBus only
+            // adapters "smbus" when they do I2C block writes, else "smbus-byte".
+            static std::unique_ptr<Transport> byName(const std::string& name,
+                                                     const std::string& dev,
+                                                     int addr)                anyexcept;
+
+        protected:
+            std::atomic<uint64_t>  syscalls { 0 };           // bus syscalls issued so far
+    };
+
+    // Plain i2c-dev: I2C_SLAVE once, then one write() per transaction.
+    class I2cDevTransport : public Transport {
+        public:
+            I2cDevTransport(const std::string& dev, int addr)                 anyexcept;
+            ~I2cDevTransport(void)                                            noexcept override;
+            I2cDevTransport(const I2cDevTransport&)                           = delete;
+            I2cDevTransport& operator=(const I2cDevTransport&)                = delete;
+
+            void  send(const unsigned char* data, size_t len)                 anyexcept override;
+            bool  canRead(void)                                               const noexcept override;
+            void  sendRecv(const unsigned char* out, size_t outLen,
+                           unsigned char* in, size_t inLen)                   anyexcept override;
+
+        private:
+            static const size_t MAX_WRITE_SIZE   { 8192 };       // i2c-dev limit for a single write()
+
+            int   fdI2c;
+    };
+
+    // I2C_RDWR ioctl: a sequence longer than one i2c_msg is split over several
+    // messages joined by repeated starts, still a single syscall.
+    class I2cRdwrTransport : public Transport {
+        public:
+            I2cRdwrTransport(const std::string& dev, int addr)                anyexcept;
+            ~I2cRdwrTransport(void)                                           noexcept override;
+            I2cRdwrTransport(const I2cRdwrTransport&)                         = delete;
+            I2cRdwrTransport& operator=(const I2cRdwrTransport&)              = delete;
+
+            void  send(const unsigned char* data, size_t len)                 anyexcept override;
+            bool  canRead(void)                                               const noexcept override;
+            void  sendRecv(const unsigned char* out, size_t outLen,
+                           unsigned char* in, size_t inLen)                   anyexcept override;
+
+        private:
+            static const size_t MAX_MSG_SIZE     { 8192 };
+            static const size_t MAX_MSGS         { 42 };         // I2C_RDWR_IOCTL_MAX_MSGS
+
+            int       fdI2c;
+            uint16_t  address;
+    };
+
+    // I2C_SMBUS ioctl, for adapters that can't do plain I2C transfers. Block
+    // mode sends the first byte as the SMBus command and up to 32 more as an
+    // I2C block: the PCF8574 latches them all alike, 33 bytes per syscall.
+    // Byte mode, the last resort, sends one byte per syscall.
+    class I2cSmbusTransport : public Transport {
+        public:
+            I2cSmbusTransport(const std::string& dev, int addr, bool block=true)
+                                                                              anyexcept;
+            ~I2cSmbusTransport(void)                                          noexcept override;
+            I2cSmbusTransport(const I2cSmbusTransport&)                       = delete;
+            I2cSmbusTransport& operator=(const I2cSmbusTransport&)            = delete;
+
+            void  send(const unsigned char* data, size_t len)                 anyexcept override;
+            bool  canRead(void)                                               const noexcept override;
+            void  sendRecv(const unsigned char* out, size_t outLen,
+                           unsigned char* in, size_t inLen)                   anyexcept override;
+
+        private:
+            static const size_t BLOCK_MAX        { 32 };         // I2C_SMBUS_BLOCK_MAX
+
+            int            fdI2c;
+            bool           blockMode;
+            unsigned long  funcs;
+    };
+
+    // Text trace, one line per transaction: nanoseconds since the sink was
+    // opened, then the bytes in hex.
+    class TraceTransport : public Transport {
+        public:
+            explicit TraceTransport(const std::string& path)                  anyexcept;
+
+            void  send(const unsigned char* data, size_t len)                 anyexcept override;
+
+        private:
+            std::ofstream    trace;
+            struct timespec  origin;
+    };
+
+    // In-memory sink for tests and benchmarks; reads return a fixed value,
+    // zero by default: an idle controller.
+    class MockTransport : public Transport {
+        public:
+            struct Record {
+                uint64_t                    ns;         // CLOCK_MONOTONIC
+                std::vector<unsigned char>  bytes;
+            };
+
+            MockTransport(void)                                               noexcept;
+
+            void  send(const unsigned char* data, size_t len)                 anyexcept override;
+            bool  canRead(void)                                               const noexcept override;
+            void  sendRecv(const unsigned char* out, size_t outLen,
+                           unsigned char* in, size_t inLen)                   anyexcept override;
+
+            const std::vector<Record>&  getRecords(void)                      const noexcept;
+            size_t                      getBytes(void)                        const noexcept;
+            size_t                      getReads(void)                        const noexcept;
+            void                        setReadValue(unsigned char value)     noexcept;
+            void                        setFailures(size_t count, int err)    noexcept;
+            void                        clear(void)                           noexcept;
+
+        private:
+            std::vector<Record>  records;
+            size_t               reads,
+                                 failures;          // next transfers failing with failErr
+            unsigned char        readValue;
+            int                  failErr;
+    };
+}
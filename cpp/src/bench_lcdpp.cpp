@@ -0,0 +1,294 @@
+/*
+# -----------------------------------------------------------------
+# simple_lcd - a command line tools to print message using Hitachi  
+#              HD44780 LCDs connected over I2C on Linux.                   
+# Copyright (C) 2020  Gabriele Bonacini
+#
+# This program is free software for no profit use; you can redistribute
+# it and/or modify it under the terms of the GNU General Public License
+# as published by the Free Software Foundation; either version 2 of
+# the License, or (at your option) any later version.
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+# You should have received a copy of the GNU General Public License
+# along with this program; if not, write to the Free Software Foundation,
+# Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301  USA
+# -----------------------------------------------------------------
+*/
+
+#include <time.h>
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <iomanip>
+#include <functional>
+#include <atomic>
+#include <new>
+#include <cstdlib>
+
+#include <lcd.hpp>
+#include <parseCmdLine.hpp>
+
+using lcd_hitachi_driver::LcdDriver;
+using lcd_hitachi_driver::TimingProfile;
+using lcd_hitachi_driver::MockTransport;
+using lcd_hitachi_driver::Transport;
+namespace encoding = lcd_hitachi_driver::encoding;
+using parcmdline::ParseCmdLine;
+using std::cout;
+using std::cerr;
+using std::string;
+using std::vector;
+using std::function;
+using std::to_string;
+using std::make_unique;
+using std::setw;
+using std::stoi;
+
+void usage(char* pname);
+
+// Counting allocator hook: every heap allocation of the process goes through
+// here, the steady state write path must not show up.
+namespace {
+    std::atomic<size_t> allocations { 0 };
+}
+
+void* operator new(size_t size){
+    allocations.fetch_add(1, std::memory_order_relaxed);
+    if(void* ptr { std::malloc(size == 0 ? 1 : size) })
+        return ptr;
+    throw std::bad_alloc();
+}
+
+void operator delete(void* ptr) noexcept{
+    std::free(ptr);
+}
+
+void operator delete(void* ptr, size_t) noexcept{
+    std::free(ptr);
+}
+
+namespace {
+    const uint64_t  NS_PER_SEC      { 1000000000ULL };
+    const size_t    MAX_WRITE_SIZE  { 8192 };       // i2c-dev limit for a single write()
+    const uint64_t  BYTE_CLOCKS     { 9 };          // 8 data bits + ack
+
+    uint64_t nowNs(void){
+        struct timespec now;
+        clock_gettime(CLOCK_MONOTONIC, &now);
+        return static_cast<uint64_t>(now.tv_sec) * NS_PER_SEC + static_cast<uint64_t>(now.tv_nsec);
+    }
+
+    struct Result {
+        string    name;
+        size_t    updates,
+                  chars,
+                  transactions,
+                  syscalls,
+                  bytes;
+        uint64_t  wallNs,
+                  sleptNs;
+    };
+
+    // Bus time of the recorded transactions at the given clock: every
+    // transaction carries the address byte too.
+    uint64_t busNs(const MockTransport& mock, uint64_t hz){
+        uint64_t clocks { 0 };
+        for(const auto& rec : mock.getRecords())
+            clocks += (rec.bytes.size() + 1) * BYTE_CLOCKS;
+        return clocks * NS_PER_SEC / hz;
+    }
+
+    Result run(const string& name, LcdDriver& lcd, MockTransport& mock, size_t updates,
+               size_t charsPerUpdate, const function<void(size_t)>& update){
+        Result    res    { name, updates, updates * charsPerUpdate, 0, 0, 0, 0, 0 };
+        uint64_t  slept  { lcd.getSleptNs() },
+                  start  { nowNs() };
+
+        mock.clear();
+        for(size_t idx { 0 }; idx < updates; ++idx)
+            update(idx);
+
+        res.wallNs  = nowNs() - start;
+        res.sleptNs = lcd.getSleptNs() - slept;
+        for(const auto& rec : mock.getRecords()){
+            res.transactions += 1;
+            res.syscalls     += (rec.bytes.size() + MAX_WRITE_SIZE - 1) / MAX_WRITE_SIZE;
+            res.bytes        += rec.bytes.size();
+        }
+        return res;
+    }
+
+    void print(const Result& res, const MockTransport& mock){
+        double    upd    { static_cast<double>(res.updates) };
+        uint64_t  cpuNs  { res.wallNs > res.sleptNs ? res.wallNs - res.sleptNs : 0 };
+
+        // On a real bus write() blocks for the transfer, then the pacer waits:
+        // modelled time is the bus time plus what the mock run measured.
+        cout << std::left << setw(14) << res.name << std::right << std::fixed << std::setprecision(2)
+             << setw(10) << (res.chars ? static_cast<double>(res.syscalls) / static_cast<double>(res.chars) : 0.0)
+             << setw(10) << static_cast<double>(res.transactions) / upd
+             << setw(10) << static_cast<double>(res.bytes) / upd
+             << setw(12) << static_cast<double>(res.sleptNs) / upd / 1000.0
+             << setw(12) << static_cast<double>(cpuNs) / upd / 1000.0
+             << setw(12) << static_cast<double>(res.wallNs + busNs(mock, 100000)) / upd / 1000.0
+             << setw(12) << static_cast<double>(res.wallNs + busNs(mock, 400000)) / upd / 1000.0
+             << "\n";
+    }
+
+    // Drops the bytes without recording them: MockTransport allocates.
+    class NullTransport : public Transport {
+        public:
+            void send(const unsigned char*, size_t) override {}
+    };
+
+    string counter(size_t value, size_t width){
+        string digits { to_string(value) };
+        return string("count: ").append(width > digits.size() ? width - digits.size() : 0, '0').append(digits);
+    }
+}
+
+int main(int argc, char** argv){
+    string               profile  { "datasheet" };
+    size_t               maxRows  { 4 },
+                         maxCols  { 20 },
+                         updates  { 50 };
+
+    constexpr char    flags[]    { "R:c:T:n:h" };
+    ParseCmdLine pcl(argc, argv, flags);
+    if(pcl.getErrorState()){
+        string exitMsg{string("Invalid  parameter or value").append(pcl.getErrorMsg())};
+        cerr << exitMsg << "\n";
+        usage(argv[0]);
+    }
+
+    if(pcl.isSet('h'))
+        usage(argv[0]);
+
+    if(pcl.isSet('R') ) 
+        maxRows = stoi(pcl.getValue('R'));
+    if(maxRows != 1 && maxRows != 2 && maxRows != 4)
+        usage(argv[0]);
+
+    if(pcl.isSet('c') ) 
+        maxCols = stoi(pcl.getValue('c'));
+    if(maxCols < 16 || maxCols >80)
+        usage(argv[0]);
+
+    if(pcl.isSet('T') ) 
+        profile = pcl.getValue('T');
+
+    if(pcl.isSet('n') ) 
+        updates = stoi(pcl.getValue('n'));
+    if(updates < 1)
+        usage(argv[0]);
+
+    try{
+        auto            bus  { make_unique<MockTransport>() };
+        MockTransport&  mock { *bus };
+        LcdDriver       lcd(std::move(bus), maxRows, maxCols);
+        lcd.setTiming(TimingProfile::byName(profile));
+
+        cout << "libslcdpp benchmark: " << maxRows << "x" << maxCols << ", timing " << profile
+             << ", " << updates << " updates per case, times in us per update\n\n"
+             << std::left << setw(14) << "case" << std::right
+             << setw(10) << "sys/char" << setw(10) << "tx/upd" << setw(10) << "bytes/upd"
+             << setw(12) << "sleep" << setw(12) << "cpu"
+             << setw(12) << "hw@100k" << setw(12) << "hw@400k" << "\n";
+
+        string full(maxCols, ' ');
+
+        print(run("init", lcd, mock, 1, 0, [&](size_t){ lcd.init(); }), mock);
+
+        print(run("line-full", lcd, mock, updates, maxCols, [&](size_t idx){
+            for(size_t col { 0 }; col < maxCols; ++col)
+                full[col] = static_cast<char>('A' + (idx + col) % 26);
+            lcd.writeLine(full, 1, true);
+        }), mock);
+
+        print(run("line-counter", lcd, mock, updates, maxCols, [&](size_t idx){
+            lcd.writeLine(counter(idx, 6), 2, true);
+        }), mock);
+
+        print(run("line-same", lcd, mock, updates, maxCols, [&](size_t){
+            lcd.writeLine(full, 1, true);
+        }), mock);
+
+        print(run("frame-full", lcd, mock, updates, maxRows * maxCols, [&](size_t idx){
+            vector<string> frame(maxRows, string(maxCols, ' '));
+            for(size_t row { 0 }; row < maxRows; ++row)
+                for(size_t col { 0 }; col < maxCols; ++col)
+                    frame[row][col] = static_cast<char>('a' + (idx + row + col) % 26);
+            lcd.writeFrame(frame);
+        }), mock);
+
+        print(run("frame-metrics", lcd, mock, updates, maxRows * maxCols, [&](size_t idx){
+            vector<string> frame;
+            for(size_t row { 0 }; row < maxRows; ++row)
+                frame.push_back(string("m").append(to_string(row)).append(" ").append(counter(idx * (row + 1), 5)));
+            lcd.writeFrame(frame);
+        }), mock);
+
+        print(run("frame-cold", lcd, mock, updates, maxRows * maxCols, [&](size_t){
+            lcd.invalidate();
+            lcd.writeFrame(vector<string>(maxRows, full));
+        }), mock);
+
+        // CPU side only: a whole frame through the line encoder.
+        const size_t           rounds  { 10000 };
+        string                 text(maxRows * maxCols, 'x');
+        vector<unsigned char>  encoded(text.size() * encoding::SEQ_SIZE);
+        uint64_t               start   { nowNs() };
+        for(size_t idx { 0 }; idx < rounds; ++idx){
+            text[idx % text.size()] = static_cast<char>('A' + idx % 26);
+            encoding::encodeLine(text, encoded.data());
+        }
+        cout << "\nencoder (" << encoding::encoderName() << "): "
+             << static_cast<double>(nowNs() - start) / rounds << " ns per frame\n";
+
+        // Heap allocations of writeLine() in steady state, after a first call:
+        // a counter rendered in place, handed over as a string_view.
+        LcdDriver  quiet(make_unique<NullTransport>(), maxRows, maxCols);
+        char       line[]  { "count: 000000" };
+        quiet.setTiming(TimingProfile::byName(profile));
+        quiet.writeLine(line, 1, true);
+
+        size_t     before  { allocations.load() };
+        for(size_t idx { 0 }; idx < updates; ++idx){
+            line[sizeof(line) - 2] = static_cast<char>('0' + idx % 10);
+            line[sizeof(line) - 3] = static_cast<char>('0' + idx / 10 % 10);
+            quiet.writeLine(std::string_view(line, sizeof(line) - 1), 1, true);
+        }
+        size_t     allocs  { allocations.load() - before };
+        cout << "writeLine heap allocations: " << static_cast<double>(allocs) / static_cast<double>(updates)
+             << " per update\n";
+        if(allocs != 0){
+            cerr << "writeLine allocates in steady state\n";
+            exit(1);
+        }
+    } catch (const std::exception& ex) {
+        cerr << ex.what() << "\nProgram exits with errors\n";
+        exit(1);
+    } catch (...) {
+        cerr << "Program exits with errors\n";
+        exit(1);
+    }
+
+    return 0;
+}
+
+void usage(char* pname){
+    cerr << "Usage:\n" << pname << " [-R rowmax] [-c colmax] [ -T timing ] [ -n updates ]\n"
+         << "\n* row_max can be 1 , 2 or 4, default 4\n"
+         << "* col_max between 16 and 80, default 20\n"
+         << "* timing can be 'datasheet', 'conservative' or a profile file path, default datasheet\n"
+         << "* updates per case, default 50\n"
+         << "\nRuns the driver against an in-memory bus and reports, per update: write()\n"
+         << "syscalls per requested character, bus transactions, bus bytes, time spent\n"
+         << "sleeping and computing, modelled time on a 100 kHz and a 400 kHz bus;\n"
+         << "then heap allocations per writeLine() in steady state, failing if any.\n";
+    exit(1);
+}
@@ -0,0 +1,208 @@
+/*
+# -----------------------------------------------------------------
+# simple_lcd - a command line tools to print message using Hitachi  
+#              HD44780 LCDs connected over I2C on Linux.                   
+# Copyright (C) 2020  Gabriele Bonacini
+#
+# This program is free software for no profit use; you can redistribute
+# it and/or modify it under the terms of the GNU General Public License
+# as published by the Free Software Foundation; either version 2 of
+# the License, or (at your option) any later version.
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+# You should have received a copy of the GNU General Public License
+# along with this program; if not, write to the Free Software Foundation,
+# Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301  USA
+# -----------------------------------------------------------------
+*/
+
+#include <lcdAsync.hpp>
+
+#include <stdexcept>
+
+namespace lcd_hitachi_driver {
+
+    using std::string;
+    using std::vector;
+    using std::unique_ptr;
+    using std::runtime_error;
+
+    AsyncLcdDriver::AsyncLcdDriver(unique_ptr<LcdDriver> drv, size_t capacity, Backpressure bp) anyexcept
+      : driver{std::move(drv)}, policy{bp}, dropped{0}, coalesced{0}, worker{capacity}
+    {
+        if(!driver)
+            throw runtime_error("AsyncLcdDriver: no driver.");
+        worker.start([this](Update& upd){ apply(upd); });
+    }
+
+    AsyncLcdDriver::~AsyncLcdDriver(void) noexcept{
+        worker.stop();
+    }
+
+    void AsyncLcdDriver::init(void) anyexcept{
+        Update upd { true, vector<RowOp>(driver->getRows(), RowOp{false, false, ""}), 1 };
+        submit(upd);
+    }
+
+    void AsyncLcdDriver::writeLine(string msg, unsigned int row, bool clean) anyexcept{
+        if(row < 1 || row > driver->getRows())
+            throw runtime_error("writeLine: invalid row number.");
+
+        Update upd { false, vector<RowOp>(driver->getRows(), RowOp{false, false, ""}), 1 };
+        upd.rows[row - 1] = { true, clean, std::move(msg) };
+        submit(upd);
+    }
+
+    void AsyncLcdDriver::writeFrame(const vector<string>& frame) anyexcept{
+        if(frame.size() > driver->getRows())
+            throw runtime_error("writeFrame: more rows than the display has.");
+
+        Update upd { false, vector<RowOp>(driver->getRows(), RowOp{false, false, ""}), 1 };
+        for(size_t idx { 0 }; idx < frame.size(); ++idx)
+            upd.rows[idx] = { true, true, frame[idx] };
+        submit(upd);
+    }
+
+    void AsyncLcdDriver::flush(void) anyexcept{
+        worker.flush();
+    }
+
+    uint64_t AsyncLcdDriver::getDropped(void) const noexcept{
+        return dropped.load();
+    }
+
+    uint64_t AsyncLcdDriver::getCoalesced(void) const noexcept{
+        return coalesced.load();
+    }
+
+    void AsyncLcdDriver::submit(Update& upd) anyexcept{
+        worker.submit(upd, [this](Update& item){
+            switch(policy){
+                case Backpressure::BLOCK:
+                    worker.waitRoom();
+                break;
+                case Backpressure::DROP_OLDEST:
+                {
+                    // The oldest update is discarded only when item rewrites all
+                    // it touched; an init or a partial write is folded into its
+                    // successor instead, and the rest queued again in order.
+                    vector<Update>  olds;
+                    Update          old;
+                    while(worker.pop(old))
+                        olds.push_back(std::move(old));
+                    if(olds.empty())
+                        break;
+                    if(supersedes(item, olds.front())){
+                        dropped.fetch_add(olds.front().weight);
+                        worker.retire(olds.front().weight);
+                    }else{
+                        merge(olds.front(), olds.size() > 1 ? olds[1] : item);
+                        coalesced.fetch_add(1);
+                    }
+                    size_t next { 1 };
+                    while(next < olds.size() && worker.push(olds[next]))
+                        ++next;
+                    // Other producers took the room back: what is left goes with item.
+                    if(next < olds.size()){
+                        for(size_t idx { next + 1 }; idx < olds.size(); ++idx)
+                            merge(olds[idx - 1], olds[idx]);
+                        merge(olds.back(), item);
+                        coalesced.fetch_add(olds.size() - next);
+                    }
+                }
+                break;
+                case Backpressure::COALESCE:
+                {
+                    // Everything queued is older than item: fold it in order,
+                    // then item on top, and queue the result as a single update.
+                    vector<Update>  olds;
+                    Update          old;
+                    while(worker.pop(old))
+                        olds.push_back(std::move(old));
+                    if(olds.empty())
+                        break;
+                    for(size_t idx { 1 }; idx < olds.size(); ++idx)
+                        merge(olds[idx - 1], olds[idx]);
+                    merge(olds.back(), item);
+                    coalesced.fetch_add(olds.size());
+                }
+                break;
+            }
+        });
+    }
+
+    void AsyncLcdDriver::merge(Update& older, Update& newer) noexcept{
+        newer.weight += older.weight;
+        // An init clears the display: what was queued before it is lost anyway.
+        if(newer.init)
+            return;
+
+        newer.init = older.init;
+        for(size_t idx { 0 }; idx < newer.rows.size(); ++idx){
+            RowOp& prev { older.rows[idx] };
+            RowOp& next { newer.rows[idx] };
+            if(!prev.set || (next.set && next.clean))
+                continue;
+            if(!next.set){
+                next = std::move(prev);
+                continue;
+            }
+            // A write without padding only replaces the head of the row.
+            if(prev.text.size() < next.text.size())
+                prev.text.resize(next.text.size(), ' ');
+            next.text  = prev.text.replace(0, next.text.size(), next.text);
+            next.clean = prev.clean;
+        }
+    }
+
+    bool AsyncLcdDriver::supersedes(const Update& newer, const Update& older) noexcept{
+        if(older.init)
+            return false;
+        if(newer.init)
+            return true;
+        for(size_t idx { 0 }; idx < older.rows.size(); ++idx)
+            if(older.rows[idx].set && !(newer.rows[idx].set && newer.rows[idx].clean))
+                return false;
+        return true;
+    }
+
+    void AsyncLcdDriver::apply(Update& upd) anyexcept{
+        // Runs on the bus thread: with COALESCE whatever queued up meanwhile
+        // is folded in, only the latest state reaches the panel.
+        if(policy == Backpressure::COALESCE){
+            Update next;
+            while(worker.pop(next)){
+                merge(upd, next);
+                upd = std::move(next);
+            }
+        }
+
+        if(upd.init)
+            driver->init();
+
+        // Clean writes of the first rows leave in a single frame; anything else
+        // goes row by row.
+        size_t  head  { 0 };
+        while(head < upd.rows.size() && upd.rows[head].set)
+            ++head;
+
+        bool    frame { head > 0 };
+        for(size_t idx { 0 }; idx < upd.rows.size(); ++idx)
+            if(upd.rows[idx].set && (!upd.rows[idx].clean || idx >= head))
+                frame = false;
+
+        if(frame){
+            vector<string> texts;
+            for(size_t idx { 0 }; idx < head; ++idx)
+                texts.push_back(upd.rows[idx].text);
+            driver->writeFrame(texts);
+            return;
+        }
+
+        for(size_t idx { 0 }; idx < upd.rows.size(); ++idx)
+            if(upd.rows[idx].set)
+                driver->writeLine(upd.rows[idx].text, static_cast<unsigned int>(idx + 1), upd.rows[idx].clean);
+    }
+}
@@ -0,0 +1,175 @@
+/*
+# -----------------------------------------------------------------
+# simple_lcd - a command line tools to print message using Hitachi  
+#              HD44780 LCDs connected over I2C on Linux.                   
+# Copyright (C) 2020  Gabriele Bonacini
+#
+# This program is free software for no profit use; you can redistribute
+# it and/or modify it under the terms of the GNU General Public License
+# as published by the Free Software Foundation; either version 2 of
+# the License, or (at your option) any later version.
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+# You should have received a copy of the GNU General Public License
+# along with this program; if not, write to the Free Software Foundation,
+# Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301  USA
+# -----------------------------------------------------------------
+*/
+
+#include <lcdCApi.h>
+#include <lcdCoalesce.hpp>
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <mutex>
+#include <cstring>
+#include <exception>
+
+using std::string;
+using std::vector;
+using std::unique_ptr;
+using std::make_unique;
+using std::mutex;
+using std::lock_guard;
+using std::exception;
+
+using lcd_hitachi_driver::LcdDriver;
+using lcd_hitachi_driver::CoalescingLcdDriver;
+using lcd_hitachi_driver::Transport;
+using lcd_hitachi_driver::TimingProfile;
+using lcd_hitachi_driver::LcdStats;
+
+struct slcd {
+    LcdDriver*                       driver;       // owned by front
+    unique_ptr<CoalescingLcdDriver>  front;
+    mutable mutex                    errLock;
+    string                           error;
+};
+
+namespace {
+
+    const unsigned int  DEFAULT_FPS { 20 };
+
+    thread_local string openError;
+
+    // Runs op, turning any exception into -1 and the handle's last error.
+    template<typename Op>
+    int guarded(const slcd_t* lcd, Op op) noexcept{
+        if(lcd == nullptr){
+            openError = "invalid handle.";
+            return -1;
+        }
+        slcd_t*  self { const_cast<slcd_t*>(lcd) };
+        try{
+            op();
+            return 0;
+        }catch(const exception& err){
+            lock_guard<mutex> lk(self->errLock);
+            self->error = err.what();
+        }catch(...){
+            lock_guard<mutex> lk(self->errLock);
+            self->error = "unknown error.";
+        }
+        return -1;
+    }
+}
+
+extern "C" {
+
+    int slcd_abi_version(void){
+        return SLCD_ABI_VERSION;
+    }
+
+    slcd_t* slcd_open(const char* device, int addr, unsigned int rows, unsigned int cols,
+                      const char* backend, const char* timing, unsigned int fps){
+        try{
+            if(device == nullptr)
+                throw std::runtime_error("slcd_open: no device.");
+
+            unique_ptr<slcd_t>     lcd { make_unique<slcd_t>() };
+            unique_ptr<LcdDriver>  drv { make_unique<LcdDriver>(
+                                            Transport::byName(backend == nullptr ? "auto" : backend,
+                                                              device, addr),
+                                            rows, cols) };
+            if(timing != nullptr)
+                drv->setTiming(TimingProfile::byName(timing));
+
+            lcd->driver = drv.get();
+            lcd->front  = make_unique<CoalescingLcdDriver>(std::move(drv),
+                                                           fps == 0 ? DEFAULT_FPS : fps);
+            return lcd.release();
+        }catch(const exception& err){
+            openError = err.what();
+        }catch(...){
+            openError = "slcd_open: unknown error.";
+        }
+        return nullptr;
+    }
+
+    void slcd_close(slcd_t* lcd){
+        // The flusher is joined before the driver goes away; a last bus error
+        // has nobody left to report to.
+        delete lcd;
+    }
+
+    int slcd_init(slcd_t* lcd){
+        return guarded(lcd, [&]{ lcd->front->init(); });
+    }
+
+    int slcd_write_line(slcd_t* lcd, const char* text, unsigned int row, int clean){
+        return guarded(lcd, [&]{ lcd->front->writeLine(text == nullptr ? "" : text, row, clean != 0); });
+    }
+
+    int slcd_write_at(slcd_t* lcd, const char* text, unsigned int row, unsigned int col){
+        return guarded(lcd, [&]{ lcd->front->writeAt(text == nullptr ? "" : text, row, col); });
+    }
+
+    int slcd_write_frame(slcd_t* lcd, const char* const* lines, size_t count){
+        return guarded(lcd, [&]{
+            if(lines == nullptr && count != 0)
+                throw std::runtime_error("slcd_write_frame: no lines.");
+
+            vector<string>  frame;
+            frame.reserve(count);
+            for(size_t row { 0 }; row < count; ++row)
+                frame.emplace_back(lines[row] == nullptr ? "" : lines[row]);
+            lcd->front->writeFrame(frame);
+        });
+    }
+
+    int slcd_flush(slcd_t* lcd){
+        return guarded(lcd, [&]{ lcd->front->flush(); });
+    }
+
+    int slcd_set_fps(slcd_t* lcd, unsigned int fps){
+        return guarded(lcd, [&]{ lcd->front->setFps(fps); });
+    }
+
+    int slcd_stats(const slcd_t* lcd, slcd_stats_t* out, size_t size){
+        return guarded(lcd, [&]{
+            if(out == nullptr)
+                throw std::runtime_error("slcd_stats: no output buffer.");
+
+            const LcdStats  st  { lcd->driver->stats() };
+            slcd_stats_t    ret { st.bytes, st.syscalls, st.transactions, st.sleptNs, st.busNs,
+                                  st.statusReads, st.retries, st.errors,
+                                  lcd->front->getSuperseded(), lcd->front->getFlushes() };
+            std::memcpy(out, &ret, size < sizeof(ret) ? size : sizeof(ret));
+        });
+    }
+
+    int slcd_reset_stats(slcd_t* lcd){
+        return guarded(lcd, [&]{ lcd->driver->resetStats(); });
+    }
+
+    const char* slcd_last_error(const slcd_t* lcd){
+        if(lcd == nullptr)
+            return openError.c_str();
+
+        lock_guard<mutex> lk(lcd->errLock);
+        return lcd->error.c_str();
+    }
+}
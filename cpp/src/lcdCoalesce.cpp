@@ -0,0 +1,207 @@
+/*
+# -----------------------------------------------------------------
+# simple_lcd - a command line tools to print message using Hitachi  
+#              HD44780 LCDs connected over I2C on Linux.                   
+# Copyright (C) 2020  Gabriele Bonacini
+#
+# This program is free software for no profit use; you can redistribute
+# it and/or modify it under the terms of the GNU General Public License
+# as published by the Free Software Foundation; either version 2 of
+# the License, or (at your option) any later version.
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+# You should have received a copy of the GNU General Public License
+# along with this program; if not, write to the Free Software Foundation,
+# Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301  USA
+# -----------------------------------------------------------------
+*/
+
+#include <lcdCoalesce.hpp>
+
+#include <stdexcept>
+
+namespace lcd_hitachi_driver {
+
+    using std::string;
+    using std::vector;
+    using std::unique_ptr;
+    using std::thread;
+    using std::mutex;
+    using std::unique_lock;
+    using std::lock_guard;
+    using std::runtime_error;
+
+    CoalescingLcdDriver::CoalescingLcdDriver(unique_ptr<LcdDriver> drv, unsigned int fps) anyexcept
+      : driver{std::move(drv)}, period{0}, pendingInit{false}, stopping{false}, flushRequest{false},
+        requested{0}, taken{0}, applied{0}, superseded{0}, flushes{0}
+    {
+        if(!driver)
+            throw runtime_error("CoalescingLcdDriver: no driver.");
+        setFps(fps);
+        target.assign(driver->getRows(), string(driver->getColumns(), ' '));
+        dirty.assign(driver->getRows(), 0);
+        flusher = thread(&CoalescingLcdDriver::run, this);
+    }
+
+    CoalescingLcdDriver::~CoalescingLcdDriver(void) noexcept{
+        {
+            lock_guard<mutex> lk(lock);
+            stopping = true;
+            wake.notify_one();
+        }
+        flusher.join();
+    }
+
+    void CoalescingLcdDriver::init(void) anyexcept{
+        lock_guard<mutex> lk(lock);
+        // The clear wipes whatever was pending.
+        for(size_t row { 0 }; row < target.size(); ++row){
+            if(dirty[row] != 0)
+                ++superseded;
+            target[row].assign(target[row].size(), ' ');
+            dirty[row] = 0;
+        }
+        pendingInit = true;
+        ++requested;
+        wake.notify_one();
+    }
+
+    void CoalescingLcdDriver::writeLine(const string& msg, unsigned int row, bool clean) anyexcept{
+        if(row < 1 || row > target.size())
+            throw runtime_error("writeLine: invalid row number.");
+
+        lock_guard<mutex> lk(lock);
+        string&  line { target[row - 1] };
+        size_t   len  { msg.size() < line.size() ? msg.size() : line.size() };
+        line.replace(0, len, msg, 0, len);
+        if(clean)
+            line.replace(len, line.size() - len, line.size() - len, ' ');
+        touch(row - 1);
+    }
+
+    void CoalescingLcdDriver::writeAt(const string& msg, unsigned int row, unsigned int col) anyexcept{
+        if(row < 1 || row > target.size())
+            throw runtime_error("writeAt: invalid row number.");
+        if(col >= driver->getColumns())
+            throw runtime_error("writeAt: invalid column number.");
+
+        lock_guard<mutex> lk(lock);
+        string&  line { target[row - 1] };
+        size_t   len  { msg.size() < line.size() - col ? msg.size() : line.size() - col };
+        line.replace(col, len, msg, 0, len);
+        touch(row - 1);
+    }
+
+    void CoalescingLcdDriver::writeFrame(const vector<string>& frame) anyexcept{
+        if(frame.size() > target.size())
+            throw runtime_error("writeFrame: more rows than the display has.");
+
+        lock_guard<mutex> lk(lock);
+        for(size_t row { 0 }; row < frame.size(); ++row){
+            string&  line { target[row] };
+            size_t   len  { frame[row].size() < line.size() ? frame[row].size() : line.size() };
+            line.replace(0, len, frame[row], 0, len);
+            line.replace(len, line.size() - len, line.size() - len, ' ');
+            if(dirty[row] != 0)
+                ++superseded;
+            dirty[row] = 1;
+        }
+        ++requested;
+        wake.notify_one();
+    }
+
+    void CoalescingLcdDriver::flush(void) anyexcept{
+        unique_lock<mutex> lk(lock);
+        const uint64_t goal { requested };
+
+        flushRequest = true;
+        wake.notify_one();
+        done.wait(lk, [&]{ return applied >= goal; });
+
+        std::exception_ptr err;
+        std::swap(err, busError);
+        lk.unlock();
+        if(err)
+            std::rethrow_exception(err);
+    }
+
+    void CoalescingLcdDriver::setFps(unsigned int fps) anyexcept{
+        if(fps == 0)
+            throw runtime_error("CoalescingLcdDriver: invalid frame rate.");
+
+        lock_guard<mutex> lk(lock);
+        period = std::chrono::duration_cast<Clock::duration>(std::chrono::seconds(1)) / fps;
+    }
+
+    uint64_t CoalescingLcdDriver::getSuperseded(void) const noexcept{
+        lock_guard<mutex> lk(lock);
+        return superseded;
+    }
+
+    uint64_t CoalescingLcdDriver::getFlushes(void) const noexcept{
+        lock_guard<mutex> lk(lock);
+        return flushes;
+    }
+
+    void CoalescingLcdDriver::touch(size_t row) noexcept{
+        if(dirty[row] != 0)
+            ++superseded;
+        dirty[row] = 1;
+        ++requested;
+        wake.notify_one();
+    }
+
+    void CoalescingLcdDriver::run(void) noexcept{
+        unique_lock<mutex>  lk(lock);
+        Clock::time_point   last { Clock::now() - period };
+
+        while(true){
+            wake.wait(lk, [&]{ return stopping || requested != taken; });
+            if(requested == taken)
+                return;
+
+            // Once per period at most, unless someone is waiting in flush().
+            wake.wait_until(lk, last + period, [&]{ return stopping || flushRequest; });
+            last = Clock::now();
+
+            bool            init   { pendingInit };
+            vector<string>  rows;
+            vector<size_t>  which;
+            for(size_t row { 0 }; row < target.size(); ++row){
+                if(dirty[row] == 0)
+                    continue;
+                rows.push_back(target[row]);
+                which.push_back(row);
+                dirty[row] = 0;
+            }
+            const uint64_t  upto   { requested };
+            pendingInit  = false;
+            flushRequest = false;
+            taken        = upto;
+            lk.unlock();
+
+            std::exception_ptr err;
+            try{
+                if(init)
+                    driver->init();
+                if(!rows.empty() && rows.size() == target.size()){
+                    driver->writeFrame(rows);
+                }else{
+                    for(size_t idx { 0 }; idx < rows.size(); ++idx)
+                        driver->writeLine(rows[idx], static_cast<unsigned int>(which[idx] + 1), true);
+                }
+            } catch (...) {
+                err = std::current_exception();
+            }
+
+            lk.lock();
+            if(err)
+                busError = err;
+            applied = upto;
+            ++flushes;
+            done.notify_all();
+        }
+    }
+}
@@ -0,0 +1,305 @@
+/*
+# -----------------------------------------------------------------
+# simple_lcd - a command line tools to print message using Hitachi  
+#              HD44780 LCDs connected over I2C on Linux.                   
+# Copyright (C) 2020  Gabriele Bonacini
+#
+# This program is free software for no profit use; you can redistribute
+# it and/or modify it under the terms of the GNU General Public License
+# as published by the Free Software Foundation; either version 2 of
+# the License, or (at your option) any later version.
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+# You should have received a copy of the GNU General Public License
+# along with this program; if not, write to the Free Software Foundation,
+# Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301  USA
+# -----------------------------------------------------------------
+*/
+
+#include <lcdEmulator.hpp>
+
+#include <fstream>
+#include <sstream>
+#include <iomanip>
+#include <stdexcept>
+
+namespace lcd_hitachi_driver {
+
+    using std::string;
+    using std::vector;
+    using std::ifstream;
+    using std::istringstream;
+    using std::ostream;
+    using std::runtime_error;
+
+    namespace {
+        const uint64_t  NS_PER_SEC  { 1000000000ULL };
+
+        uint64_t nowNs(void){
+            struct timespec now;
+            clock_gettime(CLOCK_MONOTONIC, &now);
+            return static_cast<uint64_t>(now.tv_sec) * NS_PER_SEC + static_cast<uint64_t>(now.tv_nsec);
+        }
+    }
+
+    Hd44780Emulator::Hd44780Emulator(size_t rws, size_t cols, const TimingProfile& prof,
+                                     unsigned long hz) anyexcept
+      : rows{rws}, columns{cols}, timing{prof}, busHz{hz},
+        lastByte{0}, highNibble{0}, addrCounter{0}, displayShift{0},
+        fourBit{false}, twoLines{false}, pendingHigh{false}, readLow{false}, increment{true},
+        displayOn{false}, cgramMode{false}, functionSets8{0},
+        busFree{0}, busyUntil{0}, execStart{0}, firstEdge{0}
+    {
+        if(rws != 1 && rws != 2 && rws != 4)
+            throw runtime_error("Emulator: max row number not supported.");
+        if(busHz == 0)
+            throw runtime_error("Emulator: invalid bus frequency.");
+        ddram.fill(' ');
+        cgram.fill(0);
+    }
+
+    void Hd44780Emulator::send(const unsigned char* data, size_t len) anyexcept{
+        feed(data, len, nowNs());
+        waitBus();
+    }
+
+    bool Hd44780Emulator::canRead(void) const noexcept{
+        return true;
+    }
+
+    void Hd44780Emulator::sendRecv(const unsigned char* out, size_t outLen, unsigned char* in, size_t inLen) anyexcept{
+        feed(out, outLen, nowNs());
+
+        // The port is sampled after the write part: with R/W and EN high the
+        // controller drives D7-D4, first BF and AC6-AC4, then AC3-AC0.
+        uint64_t       when   { busFree };
+        bool           busy   { when < busyUntil };
+        unsigned char  nibble { static_cast<unsigned char>(readLow ? addrCounter & 0x0F
+                                                                   : (busy ? 0x08 : 0) | ((addrCounter >> 4) & 0x07)) };
+        unsigned char  pins   { lastByte };
+        if((lastByte & RW) != 0 && (lastByte & EN) != 0)
+            pins = static_cast<unsigned char>(nibble << 4 | (lastByte & 0x0F));
+        for(size_t idx { 0 }; idx < inLen; ++idx)
+            in[idx] = pins;
+
+        busFree += (inLen + 1) * BYTE_CLOCKS * NS_PER_SEC / busHz;
+        waitBus();
+    }
+
+    void Hd44780Emulator::waitBus(void) const noexcept{
+        struct timespec done { static_cast<time_t>(busFree / NS_PER_SEC),
+                               static_cast<long>(busFree % NS_PER_SEC) };
+        while(clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &done, nullptr) == EINTR)
+            ;
+    }
+
+    void Hd44780Emulator::feed(const unsigned char* data, size_t len, uint64_t ns) noexcept{
+        if(ns < busFree)
+            ns = busFree;
+        busFree = ns + (len + 1) * BYTE_CLOCKS * NS_PER_SEC / busHz;
+
+        for(size_t idx { 0 }; idx < len; ++idx){
+            unsigned char byte { data[idx] };
+            if((lastByte & EN) != 0 && (byte & EN) == 0 && (lastByte & RW) != 0){
+                // End of a read cycle: nothing is latched, 4 bit mode moves to
+                // the other nibble.
+                if(fourBit)
+                    readLow = !readLow;
+            }else if((lastByte & EN) != 0 && (byte & EN) == 0){
+                // The address byte goes first: byte idx is complete after idx + 2 bytes.
+                uint64_t edge { ns + (idx + 2) * BYTE_CLOCKS * NS_PER_SEC / busHz };
+                latch(static_cast<unsigned char>(lastByte >> 4), (lastByte & RS) != 0, edge);
+            }
+            lastByte = byte;
+        }
+    }
+
+    void Hd44780Emulator::replay(const string& tracePath) anyexcept{
+        ifstream       trace { tracePath };
+        string         line;
+        vector<unsigned char> bytes;
+
+        if(!trace.is_open())
+            throw runtime_error(string("Can't open trace file: ").append(tracePath));
+
+        while(getline(trace, line)){
+            istringstream  fields { line };
+            uint64_t       ns;
+            unsigned int   byte;
+
+            if(!(fields >> std::dec >> ns))
+                continue;
+            bytes.clear();
+            while(fields >> std::hex >> byte)
+                bytes.push_back(static_cast<unsigned char>(byte));
+            feed(bytes.data(), bytes.size(), ns);
+        }
+    }
+
+    void Hd44780Emulator::latch(unsigned char nibble, bool rs, uint64_t ns) noexcept{
+        // 8 bit mode: D3-D0 aren't wired on the backpack and read as zero.
+        if(!fourBit){
+            firstEdge = ns;
+            execute(static_cast<unsigned char>(nibble << 4), rs, ns);
+            return;
+        }
+
+        if(!pendingHigh){
+            firstEdge   = ns;
+            highNibble  = nibble;
+            pendingHigh = true;
+            return;
+        }
+
+        pendingHigh = false;
+        execute(static_cast<unsigned char>(highNibble << 4 | nibble), rs, ns);
+    }
+
+    void Hd44780Emulator::execute(unsigned char instr, bool rs, uint64_t ns) noexcept{
+        if(firstEdge < busyUntil)
+            violations.push_back({firstEdge, instr, rs,
+                                  static_cast<unsigned long>(busyUntil - execStart),
+                                  static_cast<unsigned long>(firstEdge - execStart)});
+
+        unsigned long busy { busyTime(instr, rs) };
+        execStart = ns;
+        busyUntil = ns + busy;
+
+        if(rs){
+            writeData(instr);
+            return;
+        }
+
+        if(instr == 0x01){                                   // clear display
+            ddram.fill(' ');
+            addrCounter = 0;
+            displayShift= 0;
+            increment   = true;
+            cgramMode   = false;
+        }else if((instr & 0xFE) == 0x02){                    // return home
+            addrCounter = 0;
+            displayShift= 0;
+            cgramMode   = false;
+        }else if((instr & 0xFC) == 0x04){                    // entry mode set, display shift not modelled
+            increment   = (instr & 0x02) != 0;
+        }else if((instr & 0xF8) == 0x08){                    // display on/off control
+            displayOn   = (instr & 0x04) != 0;
+        }else if((instr & 0xF0) == 0x10){                    // cursor/display shift
+            if((instr & 0x08) == 0)
+                stepCounter((instr & 0x04) != 0);
+            else
+                displayShift = static_cast<unsigned char>((instr & 0x04) != 0 ? (displayShift + LINE_CELLS - 1) % LINE_CELLS
+                                                                              : (displayShift + 1) % LINE_CELLS);
+        }else if((instr & 0xE0) == 0x20){                    // function set
+            if(!fourBit)
+                ++functionSets8;
+            fourBit     = (instr & 0x10) == 0;
+            twoLines    = (instr & 0x08) != 0;
+        }else if((instr & 0xC0) == 0x40){                    // set CGRAM address
+            addrCounter = instr & 0x3F;
+            cgramMode   = true;
+        }else if((instr & 0x80) != 0){                       // set DDRAM address
+            addrCounter = instr & 0x7F;
+            cgramMode   = false;
+        }
+    }
+
+    void Hd44780Emulator::writeData(unsigned char data) noexcept{
+        if(cgramMode){
+            cgram[addrCounter & 0x3F] = data;
+            addrCounter = static_cast<unsigned char>((addrCounter + (increment ? 1 : CGRAM_SIZE - 1)) & 0x3F);
+            return;
+        }
+        ddram[addrCounter & 0x7F] = static_cast<char>(data);
+        stepCounter(increment);
+    }
+
+    void Hd44780Emulator::stepCounter(bool forward) noexcept{
+        // Two line mode maps 0x00-0x27 and 0x40-0x67, one line mode 0x00-0x4F.
+        if(twoLines){
+            if(forward)
+                addrCounter = addrCounter == 0x27 ? 0x40 : addrCounter == 0x67 ? 0x00 : addrCounter + 1;
+            else
+                addrCounter = addrCounter == 0x40 ? 0x27 : addrCounter == 0x00 ? 0x67 : addrCounter - 1;
+        }else{
+            if(forward)
+                addrCounter = addrCounter >= 0x4F ? 0x00 : addrCounter + 1;
+            else
+                addrCounter = addrCounter == 0x00 ? 0x4F : addrCounter - 1;
+        }
+    }
+
+    unsigned long Hd44780Emulator::busyTime(unsigned char instr, bool rs) noexcept{
+        if(rs)
+            return timing.delay(Delay::DATA);
+        if(instr == 0x00)
+            return 0;
+        if((instr & 0xFE) == 0x02 || instr == 0x01)
+            return timing.delay(Delay::CLEAR_HOME);
+        if(!fourBit && (instr & 0xE0) == 0x20){
+            // The first two 8 bit function sets of the init by instruction
+            // sequence have their own, longer, waits.
+            if(functionSets8 == 0)
+                return timing.delay(Delay::INIT_LONG);
+            if(functionSets8 == 1)
+                return timing.delay(Delay::INIT_SHORT);
+        }
+        return timing.delay(Delay::EXEC);
+    }
+
+    unsigned char Hd44780Emulator::rowBase(size_t row) const noexcept{
+        switch(row){
+            case 0:  return 0x00;
+            case 1:  return 0x40;
+            case 2:  return static_cast<unsigned char>(columns);
+            default: return static_cast<unsigned char>(0x40 + columns);
+        }
+    }
+
+    vector<string> Hd44780Emulator::getScreen(void) const noexcept{
+        vector<string> screen;
+        for(size_t row { 0 }; row < rows; ++row){
+            string line;
+            // A display shift slides the window over the 40 cells of each line.
+            unsigned char base { rowBase(row) };
+            for(size_t col { 0 }; col < columns; ++col)
+                line.push_back(ddram[(base & 0x40) + ((base & 0x3F) + col + displayShift) % LINE_CELLS]);
+            screen.push_back(line);
+        }
+        return screen;
+    }
+
+    const vector<Hd44780Emulator::Violation>& Hd44780Emulator::getViolations(void) const noexcept{
+        return violations;
+    }
+
+    bool Hd44780Emulator::isFourBit(void) const noexcept{
+        return fourBit;
+    }
+
+    bool Hd44780Emulator::isDisplayOn(void) const noexcept{
+        return displayOn;
+    }
+
+    unsigned char Hd44780Emulator::getAddressCounter(void) const noexcept{
+        return addrCounter;
+    }
+
+    void Hd44780Emulator::report(ostream& out) const noexcept{
+        string border(columns + 2, '-');
+        border.front() = border.back() = '+';
+
+        out << border << '\n';
+        for(const auto& line : getScreen())
+            out << '|' << line << "|\n";
+        out << border << '\n';
+
+        out << violations.size() << " timing violation(s)\n";
+        for(const auto& vl : violations)
+            out << "  " << (vl.rs ? "data 0x" : "instr 0x") << std::hex << std::setw(2) << std::setfill('0')
+                << static_cast<unsigned int>(vl.instr) << std::dec << std::setfill(' ')
+                << " after " << vl.elapsedNs << " ns, needs " << vl.requiredNs << " ns\n";
+    }
+}
@@ -0,0 +1,154 @@
+/*
+# -----------------------------------------------------------------
+# simple_lcd - a command line tools to print message using Hitachi  
+#              HD44780 LCDs connected over I2C on Linux.                   
+# Copyright (C) 2020  Gabriele Bonacini
+#
+# This program is free software for no profit use; you can redistribute
+# it and/or modify it under the terms of the GNU General Public License
+# as published by the Free Software Foundation; either version 2 of
+# the License, or (at your option) any later version.
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+# You should have received a copy of the GNU General Public License
+# along with this program; if not, write to the Free Software Foundation,
+# Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301  USA
+# -----------------------------------------------------------------
+*/
+
+#include <lcdEncode.hpp>
+
+#include <cstring>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <tmmintrin.h>
+#define LCD_ENCODE_SSSE3 1
+#elif defined(__aarch64__) && defined(__ARM_NEON)
+#include <arm_neon.h>
+#define LCD_ENCODE_NEON 1
+#endif
+
+namespace lcd_hitachi_driver {
+    namespace encoding {
+
+        namespace {
+            const size_t  BLOCK  { 16 };
+
+            // Output byte k of a block belongs to char k / 6 and takes its high
+            // nibble for k % 6 < 3, its low nibble otherwise. The nibbles are
+            // interleaved (h0 l0 h1 l1 ...) before the shuffle, so eight chars
+            // fill three vectors and both halves of a block share the masks.
+            struct Masks {
+                std::array<std::array<unsigned char, 16>, 3>  shuffle,
+                                                              pattern;
+            };
+
+            Masks makeMasks(unsigned char mode){
+                Masks masks;
+                for(size_t vec { 0 }; vec < 3; ++vec){
+                    for(size_t idx { 0 }; idx < 16; ++idx){
+                        size_t k   { vec * 16 + idx },
+                               pos { k % SEQ_SIZE };
+                        masks.shuffle[vec][idx] = static_cast<unsigned char>(2 * (k / SEQ_SIZE) + (pos < 3 ? 0 : 1));
+                        masks.pattern[vec][idx] = static_cast<unsigned char>(mode | LCD_BACKLIGHT | (pos % 3 == 1 ? EN : 0));
+                    }
+                }
+                return masks;
+            }
+
+            const Masks  MASKS[2] { makeMasks(0), makeMasks(MODE_RS) };
+
+            size_t encodeScalar(const unsigned char* text, size_t len, unsigned char* out, unsigned char mode){
+                const auto& row { TABLE[mode] };
+                for(size_t idx { 0 }; idx < len; ++idx)
+                    memcpy(out + idx * SEQ_SIZE, row[text[idx]].data(), SEQ_SIZE);
+                return len * SEQ_SIZE;
+            }
+
+#if defined(LCD_ENCODE_SSSE3)
+            // SSE2 has no byte shuffle: pshufb needs SSSE3, checked at run time.
+            __attribute__((target("ssse3")))
+            size_t encodeSimd(const unsigned char* text, size_t len, unsigned char* out, unsigned char mode){
+                const Masks&  masks  { MASKS[mode] };
+                const __m128i nibble { _mm_set1_epi8(static_cast<char>(0xF0)) };
+                __m128i       shuf[3],
+                              patt[3];
+                for(size_t vec { 0 }; vec < 3; ++vec){
+                    shuf[vec] = _mm_loadu_si128(reinterpret_cast<const __m128i*>(masks.shuffle[vec].data()));
+                    patt[vec] = _mm_loadu_si128(reinterpret_cast<const __m128i*>(masks.pattern[vec].data()));
+                }
+
+                size_t done { 0 };
+                for(; done + BLOCK <= len; done += BLOCK){
+                    __m128i chars { _mm_loadu_si128(reinterpret_cast<const __m128i*>(text + done)) },
+                            high  { _mm_and_si128(chars, nibble) },
+                            low   { _mm_and_si128(_mm_slli_epi16(chars, 4), nibble) },
+                            half[2] { _mm_unpacklo_epi8(high, low), _mm_unpackhi_epi8(high, low) };
+                    __m128i* dst { reinterpret_cast<__m128i*>(out + done * SEQ_SIZE) };
+                    for(size_t hf { 0 }; hf < 2; ++hf)
+                        for(size_t vec { 0 }; vec < 3; ++vec)
+                            _mm_storeu_si128(dst + hf * 3 + vec,
+                                             _mm_or_si128(_mm_shuffle_epi8(half[hf], shuf[vec]), patt[vec]));
+                }
+                return done * SEQ_SIZE + encodeScalar(text + done, len - done, out + done * SEQ_SIZE, mode);
+            }
+
+            bool hasSimd(void){
+                static const bool ssse3 { __builtin_cpu_supports("ssse3") != 0 };
+                return ssse3;
+            }
+#elif defined(LCD_ENCODE_NEON)
+            size_t encodeSimd(const unsigned char* text, size_t len, unsigned char* out, unsigned char mode){
+                const Masks&  masks  { MASKS[mode] };
+                const uint8x16_t nibble { vdupq_n_u8(0xF0) };
+                uint8x16_t    shuf[3],
+                              patt[3];
+                for(size_t vec { 0 }; vec < 3; ++vec){
+                    shuf[vec] = vld1q_u8(masks.shuffle[vec].data());
+                    patt[vec] = vld1q_u8(masks.pattern[vec].data());
+                }
+
+                size_t done { 0 };
+                for(; done + BLOCK <= len; done += BLOCK){
+                    uint8x16_t chars   { vld1q_u8(text + done) },
+                               high    { vandq_u8(chars, nibble) },
+                               low     { vshlq_n_u8(chars, 4) },
+                               half[2] { vzip1q_u8(high, low), vzip2q_u8(high, low) };
+                    unsigned char* dst { out + done * SEQ_SIZE };
+                    for(size_t hf { 0 }; hf < 2; ++hf)
+                        for(size_t vec { 0 }; vec < 3; ++vec)
+                            vst1q_u8(dst + (hf * 3 + vec) * 16, vorrq_u8(vqtbl1q_u8(half[hf], shuf[vec]), patt[vec]));
+                }
+                return done * SEQ_SIZE + encodeScalar(text + done, len - done, out + done * SEQ_SIZE, mode);
+            }
+
+            bool hasSimd(void){
+                return true;
+            }
+#endif
+        }
+
+        size_t encodeLine(std::string_view text, unsigned char* out, unsigned char mode) noexcept{
+            const unsigned char* data { reinterpret_cast<const unsigned char*>(text.data()) };
+            mode &= MODE_RS;
+#if defined(LCD_ENCODE_SSSE3) || defined(LCD_ENCODE_NEON)
+            return text.size() >= BLOCK && hasSimd() ? encodeSimd(data, text.size(), out, mode)
+                                                     : encodeScalar(data, text.size(), out, mode);
+#else
+            return encodeScalar(data, text.size(), out, mode);
+#endif
+        }
+
+        const char* encoderName(void) noexcept{
+#if defined(LCD_ENCODE_SSSE3)
+            return hasSimd() ? "ssse3" : "scalar";
+#elif defined(LCD_ENCODE_NEON)
+            return "neon";
+#else
+            return "scalar";
+#endif
+        }
+    }
+}
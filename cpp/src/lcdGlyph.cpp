@@ -0,0 +1,127 @@
+/*
+# -----------------------------------------------------------------
+# simple_lcd - a command line tools to print message using Hitachi  
+#              HD44780 LCDs connected over I2C on Linux.                   
+# Copyright (C) 2020  Gabriele Bonacini
+#
+# This program is free software for no profit use; you can redistribute
+# it and/or modify it under the terms of the GNU General Public License
+# as published by the Free Software Foundation; either version 2 of
+# the License, or (at your option) any later version.
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+# You should have received a copy of the GNU General Public License
+# along with this program; if not, write to the Free Software Foundation,
+# Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301  USA
+# -----------------------------------------------------------------
+*/
+
+#include <lcdGlyph.hpp>
+
+#include <stdexcept>
+#include <cmath>
+
+namespace lcd_hitachi_driver {
+
+    using std::string;
+    using std::vector;
+    using std::to_string;
+    using std::runtime_error;
+
+    GlyphCache::GlyphCache(const LcdDriver& drv) anyexcept
+      : driver{drv}, slots{}, tick{0}, uploads{0}
+    {
+        // Built-in sets: "bar1"-"bar4", partial cells of a horizontal bar, lit
+        // from the left; "level1"-"level7", partial cells of a vertical one, lit
+        // from the bottom. The full cell is the 0xFF block of the character ROM.
+        for(size_t cols { 1 }; cols < BAR_STEPS; ++cols){
+            unsigned char line { static_cast<unsigned char>((0x1F << (BAR_STEPS - cols)) & 0x1F) };
+            Glyph         gl;
+            gl.fill(line);
+            glyphs["bar" + to_string(cols)] = gl;
+        }
+        for(size_t lines { 1 }; lines < LEVEL_STEPS; ++lines){
+            Glyph gl;
+            for(size_t row { 0 }; row < gl.size(); ++row)
+                gl[row] = row >= gl.size() - lines ? 0x1F : 0x00;
+            glyphs["level" + to_string(lines)] = gl;
+        }
+        glyphs["up"]    = {{ 0x04, 0x0E, 0x15, 0x04, 0x04, 0x04, 0x04, 0x00 }};
+        glyphs["down"]  = {{ 0x04, 0x04, 0x04, 0x04, 0x15, 0x0E, 0x04, 0x00 }};
+    }
+
+    void GlyphCache::define(const string& name, const Glyph& glyph) anyexcept{
+        glyphs[name] = glyph;
+        for(size_t slot { 0 }; slot < slots.size(); ++slot)
+            if(slots[slot].name == name)
+                upload(slot, name);
+    }
+
+    char GlyphCache::glyph(const string& name) anyexcept{
+        if(glyphs.find(name) == glyphs.end())
+            throw runtime_error("GlyphCache: undefined glyph: " + name);
+
+        ++tick;
+        size_t victim { 0 };
+        for(size_t slot { 0 }; slot < slots.size(); ++slot){
+            if(slots[slot].name == name){
+                slots[slot].lastUse = tick;
+                return static_cast<char>(CODE_BASE + slot);
+            }
+            if(slots[slot].lastUse < slots[victim].lastUse)
+                victim = slot;
+        }
+
+        upload(victim, name);
+        slots[victim].lastUse = tick;
+        return static_cast<char>(CODE_BASE + victim);
+    }
+
+    string GlyphCache::bar(double fraction, size_t width) anyexcept{
+        double  clamped { fraction < 0.0 ? 0.0 : fraction > 1.0 ? 1.0 : fraction };
+        size_t  steps   { static_cast<size_t>(std::lround(clamped * static_cast<double>(width * BAR_STEPS))) };
+        string  ret(steps / BAR_STEPS, FULL_BLOCK);
+
+        if(steps % BAR_STEPS != 0)
+            ret.push_back(glyph("bar" + to_string(steps % BAR_STEPS)));
+        ret.resize(width, ' ');
+        return ret;
+    }
+
+    string GlyphCache::sparkline(const vector<double>& values, double low, double high) anyexcept{
+        if(!(high > low))
+            throw runtime_error("GlyphCache: invalid sparkline range.");
+
+        string ret;
+        for(double val : values){
+            double clamped { val < low ? low : val > high ? high : val };
+            size_t level   { static_cast<size_t>(std::lround((clamped - low) / (high - low) * LEVEL_STEPS)) };
+            if(level == 0)
+                ret.push_back(' ');
+            else if(level == LEVEL_STEPS)
+                ret.push_back(FULL_BLOCK);
+            else
+                ret.push_back(glyph("level" + to_string(level)));
+        }
+        return ret;
+    }
+
+    void GlyphCache::invalidate(void) noexcept{
+        for(auto& slot : slots)
+            slot = Slot{};
+    }
+
+    size_t GlyphCache::getUploads(void) const noexcept{
+        return uploads;
+    }
+
+    void GlyphCache::upload(size_t slot, const string& name) anyexcept{
+        // Mark the slot free first: a failed upload leaves unknown CGRAM content.
+        slots[slot].name.clear();
+        driver.writeCgram(static_cast<unsigned char>(slot), glyphs.at(name));
+        slots[slot].name = name;
+        ++uploads;
+    }
+}
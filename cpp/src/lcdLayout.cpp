@@ -0,0 +1,150 @@
+/*
+# -----------------------------------------------------------------
+# simple_lcd - a command line tools to print message using Hitachi  
+#              HD44780 LCDs connected over I2C on Linux.                   
+# Copyright (C) 2020  Gabriele Bonacini
+#
+# This program is free software for no profit use; you can redistribute
+# it and/or modify it under the terms of the GNU General Public License
+# as published by the Free Software Foundation; either version 2 of
+# the License, or (at your option) any later version.
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+# You should have received a copy of the GNU General Public License
+# along with this program; if not, write to the Free Software Foundation,
+# Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301  USA
+# -----------------------------------------------------------------
+*/
+
+#include <lcdLayout.hpp>
+
+#include <stdexcept>
+
+namespace lcd_hitachi_driver {
+
+    using std::string;
+    using std::vector;
+    using std::mutex;
+    using std::lock_guard;
+    using std::unique_lock;
+    using std::runtime_error;
+
+    Layout::Layout(const LcdDriver& drv) noexcept
+      : driver{drv}, screen(drv.getRows(), string(drv.getColumns(), ' ')),
+        changed{true}, frames{0}
+    {}
+
+    size_t Layout::addRegion(unsigned int row, unsigned int col, size_t width, Producer prod,
+                             Clock::duration interval, Align align) anyexcept{
+        if(row < 1 || row > driver.getRows())
+            throw runtime_error("addRegion: invalid row number.");
+        if(width == 0 || col + width > driver.getColumns())
+            throw runtime_error("addRegion: region out of the display.");
+        if(prod && interval <= Clock::duration::zero())
+            throw runtime_error("addRegion: invalid refresh interval.");
+
+        lock_guard<mutex> lk(lock);
+        for(const auto& reg : regions)
+            if(reg.row == row && col < reg.col + reg.width && reg.col < col + width)
+                throw runtime_error("addRegion: region overlapping another one.");
+
+        // Due at once: the first tick fills every region.
+        regions.push_back({row, col, width, std::move(prod), interval, Clock::now(), align, string(width, ' ')});
+        changed = true;
+        return regions.size() - 1;
+    }
+
+    void Layout::set(size_t region, const string& text) anyexcept{
+        lock_guard<mutex> lk(lock);
+        if(region >= regions.size())
+            throw runtime_error("set: invalid region.");
+
+        string fitted { fit(regions[region], text) };
+        if(fitted != regions[region].text){
+            regions[region].text = fitted;
+            changed              = true;
+            wake.notify_one();
+        }
+    }
+
+    bool Layout::tick(void) anyexcept{
+        // Producers run unlocked: a slow one delays the frame, not set().
+        Clock::time_point  now { Clock::now() };
+        vector<size_t>     due;
+        {
+            lock_guard<mutex> lk(lock);
+            for(size_t idx { 0 }; idx < regions.size(); ++idx){
+                Region& reg { regions[idx] };
+                if(!reg.producer || reg.due > now)
+                    continue;
+
+                // Missed periods are skipped, not caught up with.
+                reg.due += reg.interval;
+                if(reg.due <= now)
+                    reg.due = now + reg.interval;
+                due.push_back(idx);
+            }
+        }
+        for(size_t idx : due)
+            set(idx, regions[idx].producer());
+
+        vector<string> frame;
+        {
+            lock_guard<mutex> lk(lock);
+            if(!changed)
+                return false;
+            for(const auto& reg : regions)
+                screen[reg.row - 1].replace(reg.col, reg.width, reg.text);
+            frame   = screen;
+            changed = false;
+        }
+
+        try{
+            driver.writeFrame(frame);
+        } catch (...) {
+            // The frame never made it: the next tick tries again.
+            lock_guard<mutex> lk(lock);
+            changed = true;
+            throw;
+        }
+        frames.fetch_add(1, std::memory_order_relaxed);
+        return true;
+    }
+
+    void Layout::run(const std::atomic<bool>& stop) anyexcept{
+        while(!stop.load()){
+            tick();
+
+            // Asleep until the next producer is due or set() brings new text;
+            // the timeout bounds the delay in noticing stop.
+            unique_lock<mutex> lk(lock);
+            Clock::time_point  until { Clock::now() + std::chrono::milliseconds(100) };
+            for(const auto& reg : regions)
+                if(reg.producer && reg.due < until)
+                    until = reg.due;
+            wake.wait_until(lk, until, [this]{ return changed; });
+        }
+    }
+
+    Layout::Clock::time_point Layout::nextDue(void) const noexcept{
+        lock_guard<mutex> lk(lock);
+        Clock::time_point next { Clock::time_point::max() };
+        for(const auto& reg : regions)
+            if(reg.producer && reg.due < next)
+                next = reg.due;
+        return next;
+    }
+
+    uint64_t Layout::getFrames(void) const noexcept{
+        return frames.load(std::memory_order_relaxed);
+    }
+
+    string Layout::fit(const Region& reg, const string& text) const{
+        if(text.size() >= reg.width)
+            return text.substr(0, reg.width);
+        return reg.align == Align::LEFT ? text + string(reg.width - text.size(), ' ')
+                                        : string(reg.width - text.size(), ' ') + text;
+    }
+}
@@ -0,0 +1,164 @@
+/*
+# -----------------------------------------------------------------
+# simple_lcd - a command line tools to print message using Hitachi  
+#              HD44780 LCDs connected over I2C on Linux.                   
+# Copyright (C) 2020  Gabriele Bonacini
+#
+# This program is free software for no profit use; you can redistribute
+# it and/or modify it under the terms of the GNU General Public License
+# as published by the Free Software Foundation; either version 2 of
+# the License, or (at your option) any later version.
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+# You should have received a copy of the GNU General Public License
+# along with this program; if not, write to the Free Software Foundation,
+# Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301  USA
+# -----------------------------------------------------------------
+*/
+
+#include <lcdManager.hpp>
+
+#include <stdexcept>
+
+namespace lcd_hitachi_driver {
+
+    using std::string;
+    using std::vector;
+    using std::unique_ptr;
+    using std::make_unique;
+    using std::runtime_error;
+
+    DisplayManager::DisplayManager(size_t queueDepth) noexcept
+      : depth{queueDepth}, started{false}
+    {}
+
+    DisplayManager::~DisplayManager(void) noexcept{
+        for(auto& bus : buses)
+            bus->worker.stop();
+    }
+
+    void DisplayManager::addPanel(const string& id, const string& dev, int addr, size_t rws,
+                                  size_t cols, const string& backend, const TimingProfile& prof) anyexcept{
+        auto drv { make_unique<LcdDriver>(Transport::byName(backend, dev, addr), rws, cols) };
+        drv->setTiming(prof);
+        addPanel(id, dev, std::move(drv));
+    }
+
+    void DisplayManager::addPanel(const string& id, const string& bus, unique_ptr<LcdDriver> drv) anyexcept{
+        if(started)
+            throw runtime_error("addPanel: the manager is already running.");
+        if(!drv)
+            throw runtime_error("addPanel: no driver.");
+        if(panels.count(id) != 0)
+            throw runtime_error(string("addPanel: duplicated panel id: ").append(id));
+
+        Bus* owner { nullptr };
+        for(auto& bs : buses)
+            if(bs->device == bus)
+                owner = bs.get();
+        if(owner == nullptr){
+            buses.push_back(make_unique<Bus>(bus, depth));
+            owner = buses.back().get();
+        }
+
+        owner->drivers.push_back(std::move(drv));
+        panels[id] = { owner, owner->drivers.back().get() };
+    }
+
+    void DisplayManager::start(void) anyexcept{
+        if(started)
+            return;
+        for(auto& bus : buses)
+            bus->worker.start(&DisplayManager::apply);
+        started = true;
+    }
+
+    void DisplayManager::init(const string& id) anyexcept{
+        const Panel& pnl { route(id) };
+        Job          job { JobType::INIT, pnl.driver, 0, false, {}, 1 };
+        submit(pnl, job);
+    }
+
+    void DisplayManager::initAll(void) anyexcept{
+        for(const auto& pnl : panels)
+            init(pnl.first);
+    }
+
+    void DisplayManager::writeLine(const string& id, string msg, unsigned int row, bool clean) anyexcept{
+        const Panel& pnl { route(id) };
+        if(row < 1 || row > pnl.driver->getRows())
+            throw runtime_error("writeLine: invalid row number.");
+
+        Job job { JobType::LINE, pnl.driver, row, clean, {}, 1 };
+        job.text.push_back(std::move(msg));
+        submit(pnl, job);
+    }
+
+    void DisplayManager::writeFrame(const string& id, const vector<string>& frame) anyexcept{
+        const Panel& pnl { route(id) };
+        if(frame.size() > pnl.driver->getRows())
+            throw runtime_error("writeFrame: more rows than the display has.");
+
+        Job job { JobType::FRAME, pnl.driver, 0, true, frame, 1 };
+        submit(pnl, job);
+    }
+
+    void DisplayManager::flush(void) anyexcept{
+        // Every bus is drained before the first error, if any, is reported.
+        std::exception_ptr err;
+        for(auto& bus : buses){
+            try{
+                bus->worker.flush();
+            } catch (...) {
+                if(!err)
+                    err = std::current_exception();
+            }
+        }
+        if(err)
+            std::rethrow_exception(err);
+    }
+
+    size_t DisplayManager::getBuses(void) const noexcept{
+        return buses.size();
+    }
+
+    size_t DisplayManager::getPanels(void) const noexcept{
+        return panels.size();
+    }
+
+    const DisplayManager::Panel& DisplayManager::route(const string& id) const anyexcept{
+        if(!started)
+            throw runtime_error("DisplayManager: start() not called.");
+
+        auto pnl { panels.find(id) };
+        if(pnl == panels.end())
+            throw runtime_error(string("Unknown panel id: ").append(id));
+        return pnl->second;
+    }
+
+    void DisplayManager::submit(const Panel& pnl, Job& job) anyexcept{
+        // Jobs of distinct panels can't be folded: a full queue just waits.
+        BusWorker<Job>& worker { pnl.bus->worker };
+        worker.submit(job, [&worker](Job&){ worker.waitRoom(); });
+    }
+
+    void DisplayManager::apply(Job& job) anyexcept{
+        switch(job.type){
+            case JobType::INIT:
+                job.driver->init();
+            break;
+            case JobType::LINE:
+                job.driver->writeLine(job.text.front(), job.row, job.clean);
+            break;
+            case JobType::FRAME:
+                job.driver->writeFrame(job.text);
+            break;
+        }
+    }
+
+    DisplayManager::Bus::Bus(const string& dev, size_t queueDepth) anyexcept
+      : device{dev}, worker{queueDepth}
+    {}
+}
@@ -0,0 +1,58 @@
+/*
+# -----------------------------------------------------------------
+# simple_lcd - a command line tools to print message using Hitachi  
+#              HD44780 LCDs connected over I2C on Linux.                   
+# Copyright (C) 2020  Gabriele Bonacini
+#
+# This program is free software for no profit use; you can redistribute
+# it and/or modify it under the terms of the GNU General Public License
+# as published by the Free Software Foundation; either version 2 of
+# the License, or (at your option) any later version.
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+# You should have received a copy of the GNU General Public License
+# along with this program; if not, write to the Free Software Foundation,
+# Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301  USA
+# -----------------------------------------------------------------
+*/
+
+#include <lcdMarquee.hpp>
+
+#include <stdexcept>
+
+namespace lcd_hitachi_driver {
+
+    using std::string;
+    using std::runtime_error;
+
+    Marquee::Marquee(const LcdDriver& drv) noexcept
+      : driver{drv}, offset{0}
+    {}
+
+    void Marquee::load(const string& text, unsigned int line) anyexcept{
+        if(line != 1 && line != 2)
+            throw runtime_error("Marquee: DDRAM line must be 1 or 2.");
+
+        // Shorter texts are padded, the blanks separate the end of the text
+        // from its start when the line wraps around; longer ones don't fit.
+        string cells { text.substr(0, LINE_CELLS) };
+        cells.resize(LINE_CELLS, ' ');
+        driver.writeDdram(line == 1 ? 0x00 : 0x40, cells);
+    }
+
+    void Marquee::step(bool left) anyexcept{
+        driver.command(left ? SHIFT_LEFT : SHIFT_RIGHT);
+        offset = left ? (offset + 1) % LINE_CELLS : (offset + LINE_CELLS - 1) % LINE_CELLS;
+    }
+
+    void Marquee::home(void) anyexcept{
+        driver.command(RETURN_HOME);
+        offset = 0;
+    }
+
+    size_t Marquee::getOffset(void) const noexcept{
+        return offset;
+    }
+}
@@ -0,0 +1,167 @@
+/*
+# -----------------------------------------------------------------
+# simple_lcd - a command line tools to print message using Hitachi  
+#              HD44780 LCDs connected over I2C on Linux.                   
+# Copyright (C) 2020  Gabriele Bonacini
+#
+# This program is free software for no profit use; you can redistribute
+# it and/or modify it under the terms of the GNU General Public License
+# as published by the Free Software Foundation; either version 2 of
+# the License, or (at your option) any later version.
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+# You should have received a copy of the GNU General Public License
+# along with this program; if not, write to the Free Software Foundation,
+# Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301  USA
+# -----------------------------------------------------------------
+*/
+
+#include <lcdProtocol.hpp>
+
+#include <unistd.h>
+#include <errno.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+#include <array>
+#include <stdexcept>
+
+namespace lcd_hitachi_driver {
+    namespace protocol {
+
+        using std::string;
+        using std::vector;
+        using std::array;
+        using std::runtime_error;
+
+        namespace {
+            // Returns the number of bytes read: less than len only on end of file.
+            size_t readFull(int fd, char* data, size_t len){
+                size_t done { 0 };
+                while(done < len){
+                    ssize_t ret { read(fd, data + done, len - done) };
+                    if(ret == 0)
+                        break;
+                    if(ret < 0){
+                        if(errno == EINTR)
+                            continue;
+                        throw runtime_error(string("Socket read failed: ").append(strerror(errno)));
+                    }
+                    done += static_cast<size_t>(ret);
+                }
+                return done;
+            }
+
+            void writeFull(int fd, const char* data, size_t len){
+                while(len > 0){
+                    ssize_t ret { send(fd, data, len, MSG_NOSIGNAL) };
+                    if(ret < 0){
+                        if(errno == EINTR)
+                            continue;
+                        throw runtime_error(string("Socket write failed: ").append(strerror(errno)));
+                    }
+                    data += ret;
+                    len  -= static_cast<size_t>(ret);
+                }
+            }
+        }
+
+        bool readMessage(int fd, Message& msg) anyexcept{
+            array<char, HEADER_SIZE>  hdr;
+            size_t                    got { readFull(fd, hdr.data(), hdr.size()) };
+
+            if(got == 0)
+                return false;
+            if(got != hdr.size())
+                throw runtime_error("Truncated message header.");
+            if(hdr[0] != 'L' || hdr[1] != 'C' || static_cast<uint8_t>(hdr[2]) != VERSION)
+                throw runtime_error("Invalid message header.");
+
+            msg.type  = static_cast<MsgType>(hdr[3]);
+            msg.row   = static_cast<uint8_t>(hdr[4]);
+            msg.flags = static_cast<uint8_t>(hdr[5]);
+
+            size_t len { static_cast<size_t>(static_cast<uint8_t>(hdr[6])) << 8 | static_cast<uint8_t>(hdr[7]) };
+            msg.payload.resize(len);
+            if(readFull(fd, msg.payload.data(), len) != len)
+                throw runtime_error("Truncated message payload.");
+
+            return true;
+        }
+
+        void writeMessage(int fd, const Message& msg) anyexcept{
+            if(msg.payload.size() > MAX_PAYLOAD)
+                throw runtime_error("Message payload too long.");
+
+            array<char, HEADER_SIZE>  hdr {{ 'L', 'C', static_cast<char>(VERSION),
+                                             static_cast<char>(msg.type),
+                                             static_cast<char>(msg.row),
+                                             static_cast<char>(msg.flags),
+                                             static_cast<char>(msg.payload.size() >> 8),
+                                             static_cast<char>(msg.payload.size() & 0xFF) }};
+            string                    frame;
+            frame.reserve(hdr.size() + msg.payload.size());
+            frame.append(hdr.data(), hdr.size()).append(msg.payload);
+            writeFull(fd, frame.data(), frame.size());
+        }
+
+        LcdClient::LcdClient(const string& path) anyexcept
+          : fdSock{-1}
+        {
+            struct sockaddr_un  addr;
+            if(path.size() >= sizeof(addr.sun_path))
+                throw runtime_error("Socket path too long.");
+
+            memset(&addr, 0, sizeof(addr));
+            addr.sun_family = AF_UNIX;
+            memcpy(addr.sun_path, path.c_str(), path.size());
+
+            fdSock = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+            if(fdSock < 0)
+                throw runtime_error(string("Can't create socket: ").append(strerror(errno)));
+
+            if(connect(fdSock, reinterpret_cast<struct sockaddr*>(&addr), sizeof(addr)) < 0){
+                string err { strerror(errno) };
+                close(fdSock);
+                throw runtime_error(string("Can't connect to ").append(path).append(": ").append(err));
+            }
+        }
+
+        LcdClient::~LcdClient(void) noexcept{
+            close(fdSock);
+        }
+
+        void LcdClient::init(void) anyexcept{
+            request({MsgType::INIT, 0, 0, ""});
+        }
+
+        void LcdClient::writeLine(const string& msg, unsigned int row, bool clean) anyexcept{
+            if(row < 1 || row > UINT8_MAX)
+                throw runtime_error("writeLine: invalid row number.");
+            request({MsgType::WRITE_LINE, static_cast<uint8_t>(row), clean ? FLAG_CLEAN : uint8_t{0}, msg});
+        }
+
+        void LcdClient::writeFrame(const vector<string>& frame) anyexcept{
+            string payload;
+            for(size_t idx { 0 }; idx < frame.size(); ++idx){
+                if(idx > 0)
+                    payload.push_back('\n');
+                payload.append(frame[idx]);
+            }
+            request({MsgType::WRITE_FRAME, 0, FLAG_CLEAN, payload});
+        }
+
+        void LcdClient::request(const Message& msg) anyexcept{
+            Message reply;
+
+            writeMessage(fdSock, msg);
+            if(!readMessage(fdSock, reply) || reply.type != MsgType::REPLY)
+                throw runtime_error("No reply from simple_lcdd.");
+            if(reply.row != STATUS_OK)
+                throw runtime_error(string("simple_lcdd: ").append(reply.payload));
+        }
+    }
+}
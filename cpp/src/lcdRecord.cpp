@@ -0,0 +1,132 @@
+/*
+# -----------------------------------------------------------------
+# simple_lcd - a command line tools to print message using Hitachi  
+#              HD44780 LCDs connected over I2C on Linux.                   
+# Copyright (C) 2020  Gabriele Bonacini
+#
+# This program is free software for no profit use; you can redistribute
+# it and/or modify it under the terms of the GNU General Public License
+# as published by the Free Software Foundation; either version 2 of
+# the License, or (at your option) any later version.
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+# You should have received a copy of the GNU General Public License
+# along with this program; if not, write to the Free Software Foundation,
+# Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301  USA
+# -----------------------------------------------------------------
+*/
+
+#include <lcdRecord.hpp>
+
+#include <stdexcept>
+
+namespace lcd_hitachi_driver {
+    namespace trace {
+
+        using std::string;
+        using std::runtime_error;
+
+        namespace {
+            const char  MAGIC[]  { 'L', 'C', 'D', 'T' };
+
+            uint64_t nowNs(void){
+                struct timespec now;
+                clock_gettime(CLOCK_MONOTONIC, &now);
+                return static_cast<uint64_t>(now.tv_sec) * 1000000000ULL + static_cast<uint64_t>(now.tv_nsec);
+            }
+        }
+
+        const char* opName(Op op) noexcept{
+            switch(op){
+                case Op::INIT:          return "init";
+                case Op::WRITE_LINE:    return "writeLine";
+                case Op::WRITE_FRAME:   return "writeFrame";
+                case Op::COMMAND:       return "command";
+                case Op::WRITE_DDRAM:   return "writeDdram";
+                case Op::WRITE_CGRAM:   return "writeCgram";
+            }
+            return "unknown";
+        }
+
+        TraceWriter::TraceWriter(const string& path) anyexcept
+          : out{path, std::ios::out | std::ios::trunc | std::ios::binary}, last{0}
+        {
+            if(!out.is_open())
+                throw runtime_error(string("Can't open trace file: ").append(path));
+            out.write(MAGIC, sizeof(MAGIC));
+            out.put(static_cast<char>(VERSION));
+        }
+
+        void TraceWriter::record(Op op, bool read, unsigned char delay,
+                                 const unsigned char* data, size_t len) anyexcept{
+            uint64_t now { nowNs() };
+            out.put(static_cast<char>(static_cast<unsigned char>(op) | (read ? READ_FLAG : 0)));
+            out.put(static_cast<char>(delay));
+            putVarint(last == 0 ? 0 : now - last);
+            putVarint(len);
+            out.write(reinterpret_cast<const char*>(data), static_cast<std::streamsize>(len));
+            // Flushed per record: a crash must not lose the traffic that caused it.
+            out.flush();
+            if(!out)
+                throw runtime_error("Error writing the trace file.");
+            last = now;
+        }
+
+        void TraceWriter::putVarint(uint64_t val) anyexcept{
+            while(val >= 0x80){
+                out.put(static_cast<char>((val & 0x7F) | 0x80));
+                val >>= 7;
+            }
+            out.put(static_cast<char>(val));
+        }
+
+        TraceReader::TraceReader(const string& path) anyexcept
+          : in{path, std::ios::in | std::ios::binary}, elapsed{0}
+        {
+            char header[sizeof(MAGIC) + 1];
+            if(!in.is_open())
+                throw runtime_error(string("Can't open trace file: ").append(path));
+            if(!in.read(header, sizeof(header)) || string(header, sizeof(MAGIC)) != string(MAGIC, sizeof(MAGIC)))
+                throw runtime_error(string("Not a trace file: ").append(path));
+            if(static_cast<unsigned char>(header[sizeof(MAGIC)]) != VERSION)
+                throw runtime_error(string("Unsupported trace version: ").append(path));
+        }
+
+        bool TraceReader::next(Event& event) anyexcept{
+            int       opByte { in.get() };
+            int       delay  { in.get() };
+            uint64_t  delta,
+                      len;
+
+            if(opByte == EOF)
+                return false;
+            if(delay == EOF || !getVarint(delta) || !getVarint(len))
+                throw runtime_error("Truncated trace record.");
+
+            elapsed     += delta;
+            event.op     = static_cast<Op>(opByte & ~READ_FLAG);
+            event.read   = (opByte & READ_FLAG) != 0;
+            event.delay  = static_cast<unsigned char>(delay);
+            event.ns     = elapsed;
+            event.bytes.resize(len);
+            if(!in.read(reinterpret_cast<char*>(event.bytes.data()), static_cast<std::streamsize>(len)))
+                throw runtime_error("Truncated trace record.");
+            return true;
+        }
+
+        bool TraceReader::getVarint(uint64_t& val) anyexcept{
+            val = 0;
+            for(unsigned int shift { 0 }; shift < 64; shift += 7){
+                int byte { in.get() };
+                if(byte == EOF)
+                    return false;
+                val |= static_cast<uint64_t>(byte & 0x7F) << shift;
+                if((byte & 0x80) == 0)
+                    return true;
+            }
+            throw runtime_error("Invalid trace record.");
+        }
+    }
+}
@@ -0,0 +1,167 @@
+/*
+# -----------------------------------------------------------------
+# simple_lcd - a command line tools to print message using Hitachi  
+#              HD44780 LCDs connected over I2C on Linux.                   
+# Copyright (C) 2020  Gabriele Bonacini
+#
+# This program is free software for no profit use; you can redistribute
+# it and/or modify it under the terms of the GNU General Public License
+# as published by the Free Software Foundation; either version 2 of
+# the License, or (at your option) any later version.
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+# You should have received a copy of the GNU General Public License
+# along with this program; if not, write to the Free Software Foundation,
+# Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301  USA
+# -----------------------------------------------------------------
+*/
+
+#include <lcdTiming.hpp>
+
+#include <errno.h>
+
+#include <fstream>
+#include <stdexcept>
+
+namespace lcd_hitachi_driver {
+
+    using std::string;
+    using std::ifstream;
+    using std::runtime_error;
+    using std::stoul;
+
+    namespace {
+        const unsigned long  NS_PER_US      { 1000UL };
+        const long           NS_PER_SEC     { 1000000000L };
+        // Bit clocks between the last EN falling edge of an instruction and the
+        // first one of the next instruction queued in the same transaction:
+        // three PCF8574 bytes of nine clocks each (data + ack).
+        const unsigned long  CHAIN_CLOCKS   { 3 * 9 };
+
+        string trim(const string& str){
+            const char* blanks { " \t\r\n" };
+            size_t      first  { str.find_first_not_of(blanks) };
+            if(first == string::npos)
+                return "";
+            return str.substr(first, str.find_last_not_of(blanks) - first + 1);
+        }
+    }
+
+    unsigned long TimingProfile::delay(Delay dl) const noexcept{
+        switch(dl){
+            case Delay::EXEC:        return execNs;
+            case Delay::DATA:        return dataNs;
+            case Delay::CLEAR_HOME:  return clearHomeNs;
+            case Delay::INIT_LONG:   return initLongNs;
+            case Delay::INIT_SHORT:  return initShortNs;
+            case Delay::POWER_ON:    return powerOnNs;
+        }
+        return clearHomeNs;
+    }
+
+    unsigned long TimingProfile::chainSlackNs(void) const noexcept{
+        if(maxBusHz == 0)
+            return 0;
+        return CHAIN_CLOCKS * NS_PER_SEC / maxBusHz;
+    }
+
+    TimingProfile TimingProfile::datasheet(void) noexcept{
+        // HD44780U, fosc = 270 kHz.
+        return { 37  * NS_PER_US, 41  * NS_PER_US, 1520 * NS_PER_US,
+                 4100 * NS_PER_US, 100 * NS_PER_US, 40000 * NS_PER_US, 400000 };
+    }
+
+    TimingProfile TimingProfile::conservative(void) noexcept{
+        // Roughly 1.5x the datasheet figures: covers clones with a slow oscillator
+        // while staying short enough to chain instructions on a 400 kHz bus.
+        return { 56  * NS_PER_US, 62  * NS_PER_US, 2300 * NS_PER_US,
+                 6200 * NS_PER_US, 150 * NS_PER_US, 60000 * NS_PER_US, 400000 };
+    }
+
+    TimingProfile TimingProfile::fromFile(const string& path) anyexcept{
+        // Format: "key = value" lines, times in microseconds; '#' and ';' start
+        // a comment, "[section]" lines are ignored. Missing keys keep the
+        // conservative value.
+        TimingProfile  prof   { conservative() };
+        ifstream       cfg    { path };
+        string         line;
+
+        if(!cfg.is_open())
+            throw runtime_error(string("Can't open timing profile: ").append(path));
+
+        while(getline(cfg, line)){
+            line = trim(line.substr(0, line.find_first_of("#;")));
+            if(line.empty() || line[0] == '[')
+                continue;
+
+            size_t sep { line.find('=') };
+            if(sep == string::npos)
+                throw runtime_error(string("Invalid timing profile line: ").append(line));
+
+            string        key   { trim(line.substr(0, sep)) };
+            unsigned long value;
+            try{
+                value = stoul(trim(line.substr(sep + 1)));
+            } catch (...) {
+                throw runtime_error(string("Invalid timing profile value: ").append(line));
+            }
+
+            if(key == "exec")              prof.execNs      = value * NS_PER_US;
+            else if(key == "data")         prof.dataNs      = value * NS_PER_US;
+            else if(key == "clear_home")   prof.clearHomeNs = value * NS_PER_US;
+            else if(key == "init_long")    prof.initLongNs  = value * NS_PER_US;
+            else if(key == "init_short")   prof.initShortNs = value * NS_PER_US;
+            else if(key == "power_on")     prof.powerOnNs   = value * NS_PER_US;
+            else if(key == "max_bus_hz")   prof.maxBusHz    = value;
+            else
+                throw runtime_error(string("Unknown timing profile key: ").append(key));
+        }
+
+        return prof;
+    }
+
+    TimingProfile TimingProfile::byName(const string& name) anyexcept{
+        if(name == "datasheet")
+            return datasheet();
+        if(name == "conservative")
+            return conservative();
+        return fromFile(name);
+    }
+
+    Pacer::Pacer(void) noexcept
+      : sleptNs{0}
+    {
+        clock_gettime(CLOCK_MONOTONIC, &deadline);
+    }
+
+    void Pacer::arm(unsigned long ns) noexcept{
+        clock_gettime(CLOCK_MONOTONIC, &deadline);
+        deadline.tv_sec  += static_cast<time_t>(ns / NS_PER_SEC);
+        deadline.tv_nsec += static_cast<long>(ns % NS_PER_SEC);
+        if(deadline.tv_nsec >= NS_PER_SEC){
+            deadline.tv_sec  += 1;
+            deadline.tv_nsec -= NS_PER_SEC;
+        }
+    }
+
+    void Pacer::waitReady(void) noexcept{
+        struct timespec now;
+        clock_gettime(CLOCK_MONOTONIC, &now);
+
+        int64_t left { (static_cast<int64_t>(deadline.tv_sec) - now.tv_sec) * NS_PER_SEC
+                       + (deadline.tv_nsec - now.tv_nsec) };
+        if(left <= 0)
+            return;
+
+        // Absolute deadline: signals and scheduling jitter can't stretch the wait.
+        while(clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &deadline, nullptr) == EINTR)
+            ;
+        sleptNs += static_cast<uint64_t>(left);
+    }
+
+    uint64_t Pacer::getSleptNs(void) const noexcept{
+        return sleptNs;
+    }
+}
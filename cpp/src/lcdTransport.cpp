@@ -0,0 +1,339 @@
+/*
+# -----------------------------------------------------------------
+# simple_lcd - a command line tools to print message using Hitachi  
+#              HD44780 LCDs connected over I2C on Linux.                   
+# Copyright (C) 2020  Gabriele Bonacini
+#
+# This program is free software for no profit use; you can redistribute
+# it and/or modify it under the terms of the GNU General Public License
+# as published by the Free Software Foundation; either version 2 of
+# the License, or (at your option) any later version.
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+# You should have received a copy of the GNU General Public License
+# along with this program; if not, write to the Free Software Foundation,
+# Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301  USA
+# -----------------------------------------------------------------
+*/
+
+#include <lcdTransport.hpp>
+
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <string.h>
+#include <sys/ioctl.h>
+#include <linux/i2c.h>
+#include <linux/i2c-dev.h>
+
+#include <array>
+#include <algorithm>
+#include <iomanip>
+#include <stdexcept>
+
+namespace lcd_hitachi_driver {
+
+    using std::string;
+    using std::vector;
+    using std::array;
+    using std::unique_ptr;
+    using std::make_unique;
+    using std::runtime_error;
+
+    namespace {
+        const uint64_t  NS_PER_SEC  { 1000000000ULL };
+
+        uint64_t nowNs(void){
+            struct timespec now;
+            clock_gettime(CLOCK_MONOTONIC, &now);
+            return static_cast<uint64_t>(now.tv_sec) * NS_PER_SEC + static_cast<uint64_t>(now.tv_nsec);
+        }
+
+        int openBus(const string& dev){
+            int fd { open(dev.c_str(), O_RDWR | O_CLOEXEC) };
+            if(fd < 0)
+                throw runtime_error(string("Failed to open the i2c bus ").append(dev).append(": ").append(strerror(errno)));
+            return fd;
+        }
+    }
+
+    BusError::BusError(int err, const string& msg) noexcept
+      : runtime_error{msg + ": " + strerror(err)}, errCode{err}
+    {}
+
+    int BusError::code(void) const noexcept{
+        return errCode;
+    }
+
+    bool BusError::transient(void) const noexcept{
+        return errCode == EAGAIN || errCode == EREMOTEIO || errCode == ENXIO;
+    }
+
+    Transport::~Transport(void) noexcept {}
+
+    bool Transport::canRead(void) const noexcept{
+        return false;
+    }
+
+    void Transport::sendRecv(const unsigned char*, size_t, unsigned char*, size_t) anyexcept{
+        throw runtime_error("This transport can't read from the bus.");
+    }
+
+    uint64_t Transport::getSyscalls(void) const noexcept{
+        return syscalls.load(std::memory_order_relaxed);
+    }
+
+    unique_ptr<Transport> Transport::byName(const string& name, const string& dev, int addr) anyexcept{
+        if(name == "auto"){
+            // The widest transaction the adapter supports: a plain I2C message as
+            // long as needed, else an SMBus I2C block, else single SMBus bytes.
+            unsigned long  funcs { 0 };
+            int            fd    { openBus(dev) };
+            int            ret   { ioctl(fd, I2C_FUNCS, &funcs) };
+            close(fd);
+            if(ret < 0)
+                throw runtime_error(string("Can't read the adapter functionalities of ").append(dev));
+            if((funcs & I2C_FUNC_I2C) != 0)
+                return make_unique<I2cRdwrTransport>(dev, addr);
+            if((funcs & I2C_FUNC_SMBUS_WRITE_I2C_BLOCK) != 0)
+                return make_unique<I2cSmbusTransport>(dev, addr, true);
+            if((funcs & I2C_FUNC_SMBUS_WRITE_BYTE) != 0)
+                return make_unique<I2cSmbusTransport>(dev, addr, false);
+            throw runtime_error(string("The adapter can't write to the display: ").append(dev));
+        }
+        if(name == "i2c-dev")
+            return make_unique<I2cDevTransport>(dev, addr);
+        if(name == "rdwr")
+            return make_unique<I2cRdwrTransport>(dev, addr);
+        if(name == "smbus")
+            return make_unique<I2cSmbusTransport>(dev, addr, true);
+        if(name == "smbus-byte")
+            return make_unique<I2cSmbusTransport>(dev, addr, false);
+        if(name == "trace")
+            return make_unique<TraceTransport>(dev);
+        if(name == "mock")
+            return make_unique<MockTransport>();
+        throw runtime_error(string("Unknown transport: ").append(name));
+    }
+
+    I2cDevTransport::I2cDevTransport(const string& dev, int addr) anyexcept
+      : fdI2c{openBus(dev)}
+    {
+        if(ioctl(fdI2c, I2C_SLAVE, addr) < 0){
+            close(fdI2c);
+            throw runtime_error("Failed to acquire bus access and/or talk to slave.");
+        }
+    }
+
+    I2cDevTransport::~I2cDevTransport(void) noexcept{
+        close(fdI2c);
+    }
+
+    void I2cDevTransport::send(const unsigned char* data, size_t len) anyexcept{
+        // The PCF8574 latches every byte of a transaction on its outputs, so a whole
+        // command/character sequence can travel in a single write(): one start/stop
+        // framing and one syscall instead of one per byte.
+        while(len > 0){
+            size_t chunk { len > MAX_WRITE_SIZE ? MAX_WRITE_SIZE : len };
+            syscalls.fetch_add(1, std::memory_order_relaxed);
+            ssize_t ret { write(fdI2c, data, chunk) };
+            if(ret != static_cast<ssize_t>(chunk))
+                throw BusError(ret < 0 ? errno : EIO, "Failed to write cmd to the i2c bus");
+            data += chunk;
+            len  -= chunk;
+        }
+    }
+
+    bool I2cDevTransport::canRead(void) const noexcept{
+        return true;
+    }
+
+    void I2cDevTransport::sendRecv(const unsigned char* out, size_t outLen, unsigned char* in, size_t inLen) anyexcept{
+        send(out, outLen);
+        syscalls.fetch_add(1, std::memory_order_relaxed);
+        ssize_t ret { read(fdI2c, in, inLen) };
+        if(ret != static_cast<ssize_t>(inLen))
+            throw BusError(ret < 0 ? errno : EIO, "Failed to read from the i2c bus");
+    }
+
+    I2cRdwrTransport::I2cRdwrTransport(const string& dev, int addr) anyexcept
+      : fdI2c{openBus(dev)}, address{static_cast<uint16_t>(addr)}
+    {}
+
+    I2cRdwrTransport::~I2cRdwrTransport(void) noexcept{
+        close(fdI2c);
+    }
+
+    void I2cRdwrTransport::send(const unsigned char* data, size_t len) anyexcept{
+        array<struct i2c_msg, MAX_MSGS>  msgs;
+
+        while(len > 0){
+            struct i2c_rdwr_ioctl_data  rdwr { msgs.data(), 0 };
+            while(len > 0 && rdwr.nmsgs < MAX_MSGS){
+                size_t          chunk { len > MAX_MSG_SIZE ? MAX_MSG_SIZE : len };
+                struct i2c_msg& msg   { msgs[rdwr.nmsgs++] };
+                msg.addr  = address;
+                msg.flags = 0;
+                msg.len   = static_cast<uint16_t>(chunk);
+                msg.buf   = const_cast<unsigned char*>(data);
+                data += chunk;
+                len  -= chunk;
+            }
+            syscalls.fetch_add(1, std::memory_order_relaxed);
+            int ret { ioctl(fdI2c, I2C_RDWR, &rdwr) };
+            if(ret != static_cast<int>(rdwr.nmsgs))
+                throw BusError(ret < 0 ? errno : EIO, "Failed to write cmd to the i2c bus (I2C_RDWR)");
+        }
+    }
+
+    bool I2cRdwrTransport::canRead(void) const noexcept{
+        return true;
+    }
+
+    void I2cRdwrTransport::sendRecv(const unsigned char* out, size_t outLen, unsigned char* in, size_t inLen) anyexcept{
+        if(outLen > MAX_MSG_SIZE || inLen > MAX_MSG_SIZE)
+            throw runtime_error("I2C_RDWR: transfer too long.");
+
+        // Write and read joined by a repeated start.
+        struct i2c_msg              msgs[2] { { address, 0,        static_cast<uint16_t>(outLen),
+                                                const_cast<unsigned char*>(out) },
+                                              { address, I2C_M_RD, static_cast<uint16_t>(inLen), in } };
+        struct i2c_rdwr_ioctl_data  rdwr    { msgs, 2 };
+        syscalls.fetch_add(1, std::memory_order_relaxed);
+        int ret { ioctl(fdI2c, I2C_RDWR, &rdwr) };
+        if(ret != 2)
+            throw BusError(ret < 0 ? errno : EIO, "Failed to read from the i2c bus (I2C_RDWR)");
+    }
+
+    I2cSmbusTransport::I2cSmbusTransport(const string& dev, int addr, bool block) anyexcept
+      : fdI2c{openBus(dev)}, blockMode{block}, funcs{0}
+    {
+        if(ioctl(fdI2c, I2C_SLAVE, addr) < 0 || ioctl(fdI2c, I2C_FUNCS, &funcs) < 0){
+            close(fdI2c);
+            throw runtime_error("Failed to acquire bus access and/or talk to slave.");
+        }
+        unsigned long needed { static_cast<unsigned long>(blockMode ? I2C_FUNC_SMBUS_WRITE_I2C_BLOCK : I2C_FUNC_SMBUS_WRITE_BYTE) };
+        if((funcs & needed) == 0){
+            close(fdI2c);
+            throw runtime_error(string("The adapter doesn't support SMBus ").append(blockMode ? "block" : "byte").append(" writes."));
+        }
+    }
+
+    I2cSmbusTransport::~I2cSmbusTransport(void) noexcept{
+        close(fdI2c);
+    }
+
+    void I2cSmbusTransport::send(const unsigned char* data, size_t len) anyexcept{
+        while(len > 0){
+            union i2c_smbus_data        block;
+            struct i2c_smbus_ioctl_data args  { I2C_SMBUS_WRITE, data[0], I2C_SMBUS_BYTE, nullptr };
+            size_t                      chunk { 1 };
+
+            // A lone byte goes as SMBus send byte: empty blocks upset some drivers.
+            if(blockMode && len > 1){
+                chunk           = len - 1 > BLOCK_MAX ? BLOCK_MAX + 1 : len;
+                block.block[0]  = static_cast<unsigned char>(chunk - 1);
+                std::copy(data + 1, data + chunk, block.block + 1);
+                args.size       = I2C_SMBUS_I2C_BLOCK_DATA;
+                args.data       = &block;
+            }
+
+            syscalls.fetch_add(1, std::memory_order_relaxed);
+            if(ioctl(fdI2c, I2C_SMBUS, &args) < 0)
+                throw BusError(errno, "Failed to write cmd to the i2c bus (I2C_SMBUS)");
+            data += chunk;
+            len  -= chunk;
+        }
+    }
+
+    bool I2cSmbusTransport::canRead(void) const noexcept{
+        return (funcs & I2C_FUNC_SMBUS_READ_BYTE) != 0;
+    }
+
+    void I2cSmbusTransport::sendRecv(const unsigned char* out, size_t outLen, unsigned char* in, size_t inLen) anyexcept{
+        // SMBus has no write-then-read of raw bytes: the port is sampled by
+        // receive byte transfers right after the write.
+        send(out, outLen);
+        for(size_t idx { 0 }; idx < inLen; ++idx){
+            union i2c_smbus_data        byte;
+            struct i2c_smbus_ioctl_data args  { I2C_SMBUS_READ, 0, I2C_SMBUS_BYTE, &byte };
+            syscalls.fetch_add(1, std::memory_order_relaxed);
+            if(ioctl(fdI2c, I2C_SMBUS, &args) < 0)
+                throw BusError(errno, "Failed to read from the i2c bus (I2C_SMBUS)");
+            in[idx] = byte.byte;
+        }
+    }
+
+    TraceTransport::TraceTransport(const string& path) anyexcept
+      : trace{path, std::ios::out | std::ios::trunc}
+    {
+        if(!trace.is_open())
+            throw runtime_error(string("Can't open trace file: ").append(path));
+        clock_gettime(CLOCK_MONOTONIC, &origin);
+    }
+
+    void TraceTransport::send(const unsigned char* data, size_t len) anyexcept{
+        uint64_t start { static_cast<uint64_t>(origin.tv_sec) * NS_PER_SEC + static_cast<uint64_t>(origin.tv_nsec) };
+
+        trace << std::dec << (nowNs() - start) << std::hex << std::setfill('0');
+        for(size_t idx { 0 }; idx < len; ++idx)
+            trace << ' ' << std::setw(2) << static_cast<unsigned int>(data[idx]);
+        trace << '\n';
+        if(!trace.flush())
+            throw runtime_error("Failed to write the trace file.");
+    }
+
+    MockTransport::MockTransport(void) noexcept
+      : reads{0}, failures{0}, readValue{0}, failErr{0}
+    {}
+
+    void MockTransport::send(const unsigned char* data, size_t len) anyexcept{
+        if(failures > 0){
+            --failures;
+            throw BusError(failErr, "Mock transfer failure");
+        }
+        records.push_back({nowNs(), vector<unsigned char>(data, data + len)});
+    }
+
+    bool MockTransport::canRead(void) const noexcept{
+        return true;
+    }
+
+    void MockTransport::sendRecv(const unsigned char* out, size_t outLen, unsigned char* in, size_t inLen) anyexcept{
+        send(out, outLen);
+        for(size_t idx { 0 }; idx < inLen; ++idx)
+            in[idx] = readValue;
+        ++reads;
+    }
+
+    size_t MockTransport::getReads(void) const noexcept{
+        return reads;
+    }
+
+    void MockTransport::setReadValue(unsigned char value) noexcept{
+        readValue = value;
+    }
+
+    const vector<MockTransport::Record>& MockTransport::getRecords(void) const noexcept{
+        return records;
+    }
+
+    size_t MockTransport::getBytes(void) const noexcept{
+        size_t total { 0 };
+        for(const auto& rec : records)
+            total += rec.bytes.size();
+        return total;
+    }
+
+    void MockTransport::setFailures(size_t count, int err) noexcept{
+        failures = count;
+        failErr  = err;
+    }
+
+    void MockTransport::clear(void) noexcept{
+        records.clear();
+        reads = 0;
+    }
+}
@@ -20,14 +20,36 @@
 
 #include <lcd.hpp>
 
+#include <stdexcept>
+#include <algorithm>
+
 namespace lcd_hitachi_driver {
 
     using std::string;
     using std::cerr;
     using std::hex;
+    using std::vector;
+    using std::runtime_error;
+    using std::unique_ptr;
+    using std::make_unique;
+
+    namespace {
+        uint64_t monotonicNs(void){
+            struct timespec now;
+            clock_gettime(CLOCK_MONOTONIC, &now);
+            return static_cast<uint64_t>(now.tv_sec) * 1000000000ULL + static_cast<uint64_t>(now.tv_nsec);
+        }
+    }
 
     LcdDriver::LcdDriver(int addr, size_t rws, size_t cols, const string& dev)  anyexcept
-      : rows{rws}, columns{cols}, address{addr}, device{dev}
+      : LcdDriver(Transport::byName("auto", dev, addr), rws, cols)
+    {}
+
+    LcdDriver::LcdDriver(unique_ptr<Transport> tr, size_t rws, size_t cols)  anyexcept
+      : rows{rws}, columns{cols}, bus{std::move(tr)},
+        timing{TimingProfile::conservative()}, apiOp{trace::Op::INIT},
+        pollBusy{false}, pollTimeoutNs{DEFAULT_POLL_TIMEOUT},
+        retryLimit{DEFAULT_RETRIES}, retryBackoffNs{DEFAULT_BACKOFF}
     {
         switch(rws){
             case 4:
@@ -40,79 +62,382 @@ namespace lcd_hitachi_driver {
                addrs = { 0x80 };
             break;
             default:
-		       cerr << "Max row number not supported.\n";
-               throw;
-        }
-        fdI2c   = open(device.c_str(), O_RDWR);
-	    if (fdI2c < 0) {
-		    cerr << "Failed to open the i2c bus\n";
-            throw;
+               throw runtime_error("Max row number not supported.");
         }
 
-        if (ioctl(fdI2c, I2C_SLAVE, address) < 0) {
-		    cerr << "Failed to acquire bus access and/or talk to slave.\n";
-            throw;
-        }
+        txBuff.reserve(rows * (columns + 1) * OUTPUT_BUFF_SIZE);
+        txMarks.reserve(rows * (columns + 1));
+        shadow.assign(rows * columns, ' ');
+        shadowValid.assign(rows * columns, 0);
 	}
 
-    LcdDriver::~LcdDriver(void) noexcept {
-        close(fdI2c);
-    }
+    LcdDriver::~LcdDriver(void) noexcept {}
 
-    void LcdDriver::writeLine(string msg, unsigned int row, bool clean) const anyexcept {
+    void LcdDriver::writeLine(std::string_view msg, unsigned int row, bool clean) const anyexcept {
+        // No copy of msg, no padding string: the cells are diffed and encoded
+        // straight into the preallocated transmit buffer, nothing is allocated.
+        apiOp = trace::Op::WRITE_LINE;
         try{
-            const unsigned char MODE_RS = 0x1;
-
-            hexCmd(addrs[row-1], 0);
-            usleep(50000);
-    
-            if(msg.size() < columns && clean)
-                 msg.append(static_cast<size_t>(columns - msg.size()), ' ');
-    
-            if(msg.size() > columns)
-                 msg.erase(columns, msg.size()-columns);
-    
-            for(auto& el : msg) {
-               hexCmd(el, MODE_RS);
-               usleep(50000);
-            }
+            queueRow(msg, row, clean);
+            sendBuffer();
         } catch (...) {
 		        cerr << "Error: writeLine()\n";
                 throw;
         }
     }
 
+    void LcdDriver::writeFrame(const vector<string>& frame) const anyexcept {
+        apiOp = trace::Op::WRITE_FRAME;
+        try{
+            if(frame.size() > rows)
+                throw runtime_error("writeFrame: more rows than the display has.");
+
+            // The whole screen is expanded in the transmit buffer and leaves in a
+            // single flush: instructions are chained as long as the timing allows.
+            for(size_t idx { 0 }; idx < frame.size(); ++idx)
+                queueRow(frame[idx], static_cast<unsigned int>(idx + 1), true);
+            sendBuffer();
+        } catch (...) {
+		        cerr << "Error: writeFrame()\n";
+                throw;
+        }
+    }
+
+    void LcdDriver::queueRow(std::string_view msg, unsigned int row, bool clean) const anyexcept {
+        const diff::Shadow screen { shadow.data(), shadowValid.data(), addrs.data(), rows, columns };
+        diff::updateRow(screen, msg, row, clean, [this](unsigned char cmd, const char* data, size_t len){
+            hexCmd(cmd, 0);
+            queueData(data, len);
+        });
+    }
+
     void LcdDriver::hexCmd(unsigned char cmd, unsigned char mode) const anyexcept {
-        unsigned char first  { static_cast<unsigned char>(mode | ( cmd & 0xF0 )) };
-        unsigned char second { static_cast<unsigned char>(mode | ( (cmd << 4 ) & 0xF0 )) };
-
-        output[0]=(first | LCD_BACKLIGHT );
-        output[1]=(first | EN | LCD_BACKLIGHT);
-        output[2]=((first & (~EN)) | LCD_BACKLIGHT );
-    
-        output[3]=(second | LCD_BACKLIGHT );
-        output[4]=(second | EN | LCD_BACKLIGHT );
-        output[5]=((second & (~EN)) | LCD_BACKLIGHT );
-    
-        for(auto& col : output){
-	         if (write(fdI2c, &col, sizeof(unsigned char)) != sizeof(unsigned char)){ 
-		         cerr << "Error: Failed to write cmd to the i2c bus.\n";
-                 throw;
-	         }
-             usleep(50000);
+        const encoding::Sequence& seq { encoding::TABLE[mode & encoding::MODE_RS][cmd] };
+        txBuff.insert(txBuff.end(), seq.begin(), seq.end());
+
+        if(mode != 0)
+            txMarks.push_back({txBuff.size(), Delay::DATA});
+        else if(cmd == 0x01 || (cmd & 0xFE) == 0x02)
+            txMarks.push_back({txBuff.size(), Delay::CLEAR_HOME});
+        else
+            txMarks.push_back({txBuff.size(), Delay::EXEC});
+    }
+
+    void LcdDriver::queueData(const char* data, size_t len) const anyexcept {
+        size_t start { txBuff.size() };
+        txBuff.resize(start + len * OUTPUT_BUFF_SIZE);
+        encoding::encodeLine(std::string_view(data, len), txBuff.data() + start);
+        for(size_t idx { 1 }; idx <= len; ++idx)
+            txMarks.push_back({start + idx * OUTPUT_BUFF_SIZE, Delay::DATA});
+    }
+
+    void LcdDriver::queueBytes(const unsigned char* data, size_t len, Delay dl) const anyexcept {
+        txBuff.insert(txBuff.end(), data, data + len);
+        txMarks.push_back({txBuff.size(), dl});
+    }
+
+    void LcdDriver::sendBuffer(bool mayPoll) const anyexcept {
+        // A transient bus error costs a backoff, a nibble resync and a replay,
+        // not a new init: the controller still holds its DDRAM, only the
+        // transfer in flight is lost.
+        unsigned long backoff { retryBackoffNs };
+        for(unsigned int attempt { 0 }; ; ++attempt){
+            try{
+                if(attempt > 0)
+                    recover();
+                flushBuffer(mayPoll);
+                break;
+            } catch (const BusError& err) {
+                if(!err.transient() || attempt >= retryLimit){
+                    discard();
+                    throw;
+                }
+                counters.retries.fetch_add(1, std::memory_order_relaxed);
+                pacer.arm(backoff);
+                pace();
+                backoff *= 2;
+            } catch (...) {
+                discard();
+                throw;
+            }
+        }
+        txBuff.clear();
+        txMarks.clear();
+    }
+
+    void LcdDriver::flushBuffer(bool mayPoll) const anyexcept {
+        // Instructions whose execution time is shorter than the bus time needed to
+        // reach the next EN edge are chained in one transaction; a slower one
+        // closes the transaction and the next one waits for its deadline.
+        // Polling the busy flag trusts the controller, not the profile: every
+        // instruction gets its own transaction and its own check.
+        const unsigned long slack { mayPoll && pollBusy ? 0 : timing.chainSlackNs() };
+        size_t              start { 0 };
+        for(size_t idx { 0 }; idx < txMarks.size(); ++idx){
+            const TxMark&  mark  { txMarks[idx] };
+            unsigned long  wait  { timing.delay(mark.delay) };
+            if(wait <= slack && idx + 1 < txMarks.size())
+                continue;
+
+            waitReady(mayPoll);
+            transfer(static_cast<unsigned char>(mark.delay), txBuff.data() + start, mark.end - start);
+            pacer.arm(wait);
+            start = mark.end;
+        }
+    }
+
+    void LcdDriver::discard(void) const noexcept {
+        // What reached the panel is unknown: the next update rewrites it all.
+        txBuff.clear();
+        txMarks.clear();
+        invalidate();
+    }
+
+    void LcdDriver::recover(void) const anyexcept {
+        // A transfer cut short can leave the controller between the two nibbles
+        // of a byte. Three 0x3 nibbles bring it to 8 bit mode from either state,
+        // a 0x2 back to 4 bit, then the init settings, all but the clear: none
+        // of this touches DDRAM. The update in flight waits aside meanwhile.
+        txBuff.swap(spareBuff);
+        txMarks.swap(spareMarks);
+        txBuff.clear();
+        txMarks.clear();
+        try{
+            for(size_t idx { 0 }; idx < RESYNC_ROWS; ++idx)
+                queueBytes(resyncMatrix[idx].data(), resyncMatrix[idx].size(), resyncDelays[idx]);
+            hexCmd(0x28, 0);
+            hexCmd(0x0C, 0);
+            hexCmd(0x06, 0);
+            flushBuffer(false);
+        } catch (...) {
+            txBuff.swap(spareBuff);
+            txMarks.swap(spareMarks);
+            throw;
+        }
+        txBuff.swap(spareBuff);
+        txMarks.swap(spareMarks);
+
+        // Screen updates are replayed from the shadow copy, which already holds
+        // their content: every known cell, the partial writes fixed as well.
+        // Anything else (init, commands, raw DDRAM/CGRAM writes) begins with its
+        // own addressing and is simply sent again.
+        if(apiOp == trace::Op::WRITE_LINE || apiOp == trace::Op::WRITE_FRAME){
+            txBuff.clear();
+            txMarks.clear();
+            for(size_t row { 0 }; row < rows; ++row){
+                std::fill_n(shadowValid.begin() + static_cast<long>(row * columns), columns, 0);
+                queueRow(std::string_view(shadow.data() + row * columns, columns), static_cast<unsigned int>(row + 1), true);
+            }
         }
     }
 
     void LcdDriver::init(void) const anyexcept{
-        for( auto& row : initMatrix){
-           for( auto& elem : row){
-	            if (write(fdI2c, &elem, sizeof(unsigned char)) != sizeof(unsigned char)){ 
-		            cerr << "Error: Failed to write to the i2c bus.\n";
-                    throw;
-	            }
-                usleep(50000);
+        apiOp = trace::Op::INIT;
+        pacer.arm(timing.delay(Delay::POWER_ON));
+        for(size_t idx { 0 }; idx < INIT_ROWS; ++idx)
+           queueBytes(initMatrix[idx].data(), initMatrix[idx].size(), initDelays[idx]);
+        // The busy flag can't be trusted before the interface is set up.
+        sendBuffer(false);
+
+        // The init sequence ends with a clear: the whole DDRAM holds spaces.
+        shadow.assign(shadow.size(), ' ');
+        shadowValid.assign(shadowValid.size(), 1);
+    }
+
+    void LcdDriver::command(unsigned char cmd) const anyexcept {
+        apiOp = trace::Op::COMMAND;
+        try{
+            hexCmd(cmd, 0);
+            sendBuffer();
+
+            // The shadow copy follows DDRAM: a clear leaves spaces everywhere.
+            // Return home, cursor/display shifts, display control and address
+            // commands move the cursor or the window but leave DDRAM alone, and
+            // every row write sets its own address. Entry mode and function set
+            // change how later data lands, so nothing is trusted any more.
+            if(cmd == 0x01){
+                shadow.assign(shadow.size(), ' ');
+                shadowValid.assign(shadowValid.size(), 1);
+            } else if((cmd & 0xFC) == 0x04 || (cmd & 0xE0) == 0x20){
+                invalidate();
+            }
+        } catch (...) {
+		        cerr << "Error: command()\n";
+                throw;
+        }
+    }
+
+    void LcdDriver::writeDdram(unsigned char addr, const string& data) const anyexcept {
+        apiOp = trace::Op::WRITE_DDRAM;
+        try{
+            // Raw DDRAM write, visible or not: cells mapped to a row are kept in
+            // the shadow copy. addr is a DDRAM address, 0x00-0x27 or 0x40-0x67.
+            for(size_t idx { 0 }; idx < data.size(); ++idx){
+                size_t cell { static_cast<size_t>(addr) + idx };
+                for(size_t row { 0 }; row < rows; ++row){
+                    size_t base { static_cast<size_t>(addrs[row] & 0x7F) };
+                    if(cell >= base && cell < base + columns){
+                        shadow[row * columns + cell - base]      = data[idx];
+                        shadowValid[row * columns + cell - base] = 1;
+                    }
+                }
             }
+            hexCmd(static_cast<unsigned char>(0x80 | addr), 0);
+            queueData(data.data(), data.size());
+            sendBuffer();
+        } catch (...) {
+		        cerr << "Error: writeDdram()\n";
+                throw;
+        }
+    }
+
+    void LcdDriver::writeCgram(unsigned char slot, const Glyph& glyph) const anyexcept {
+        apiOp = trace::Op::WRITE_CGRAM;
+        try{
+            if(slot >= CGRAM_SLOTS)
+                throw runtime_error("writeCgram: invalid CGRAM slot.");
+
+            // Address and the eight pixel rows leave in one transaction. The address
+            // counter is left in CGRAM: every DDRAM write starts with its own address.
+            hexCmd(static_cast<unsigned char>(0x40 | slot << 3), 0);
+            queueData(reinterpret_cast<const char*>(glyph.data()), glyph.size());
+            sendBuffer();
+        } catch (...) {
+		        cerr << "Error: writeCgram()\n";
+                throw;
+        }
+    }
+
+    void LcdDriver::invalidate(void) const noexcept {
+        shadowValid.assign(shadowValid.size(), 0);
+    }
+
+    void LcdDriver::waitReady(bool mayPoll) const anyexcept {
+        if(!mayPoll || !pollBusy){
+            pace();
+            return;
+        }
+
+        // Move on as soon as the controller says it's ready; if it never does
+        // the panel can't be read back: timed delays from now on.
+        struct timespec now;
+        clock_gettime(CLOCK_MONOTONIC, &now);
+        uint64_t deadline { static_cast<uint64_t>(now.tv_sec) * 1000000000ULL
+                            + static_cast<uint64_t>(now.tv_nsec) + pollTimeoutNs };
+        while(true){
+            if((readStatus() & BUSY_FLAG) == 0)
+                return;
+            clock_gettime(CLOCK_MONOTONIC, &now);
+            if(static_cast<uint64_t>(now.tv_sec) * 1000000000ULL + static_cast<uint64_t>(now.tv_nsec) >= deadline)
+                break;
+        }
+
+        cerr << "Busy flag polling timed out, using timed delays.\n";
+        pollBusy = false;
+        pace();
+    }
+
+    unsigned char LcdDriver::readStatus(void) const anyexcept {
+        // Two read cycles, each one raising EN and sampling the port: BF and
+        // AC6-AC4 first, then AC3-AC0.
+        const unsigned char cycle[] { READ_IDLE, READ_EN };
+        const unsigned char idle[]  { READ_IDLE };
+        unsigned char       high,
+                            low;
+
+        transfer(trace::NO_DELAY, cycle, sizeof(cycle), &high, 1);
+        transfer(trace::NO_DELAY, cycle, sizeof(cycle), &low, 1);
+        transfer(trace::NO_DELAY, idle, sizeof(idle));
+        counters.statusReads.fetch_add(1, std::memory_order_relaxed);
+
+        return static_cast<unsigned char>((high & 0xF0) | (low >> 4));
+    }
+
+    void LcdDriver::pace(void) const noexcept {
+        uint64_t before { pacer.getSleptNs() };
+        pacer.waitReady();
+        counters.sleptNs.fetch_add(pacer.getSleptNs() - before, std::memory_order_relaxed);
+    }
+
+    void LcdDriver::transfer(unsigned char delay, const unsigned char* out, size_t outLen,
+                             unsigned char* in, size_t inLen) const anyexcept {
+        // Traced before sending: a transaction that fails is the interesting one.
+        if(recorder)
+            recorder->record(apiOp, in != nullptr, delay, out, outLen);
+
+        uint64_t  calls  { bus->getSyscalls() },
+                  start  { monotonicNs() };
+        try{
+            if(in == nullptr)
+                bus->send(out, outLen);
+            else
+                bus->sendRecv(out, outLen, in, inLen);
+        } catch (...) {
+            counters.errors.fetch_add(1, std::memory_order_relaxed);
+            counters.syscalls.fetch_add(bus->getSyscalls() - calls, std::memory_order_relaxed);
+            throw;
         }
+        counters.busNs.fetch_add(monotonicNs() - start, std::memory_order_relaxed);
+        counters.syscalls.fetch_add(bus->getSyscalls() - calls, std::memory_order_relaxed);
+        counters.bytes.fetch_add(outLen + inLen, std::memory_order_relaxed);
+        counters.transactions.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    LcdStats LcdDriver::stats(void) const noexcept {
+        const auto mo { std::memory_order_relaxed };
+        return { counters.bytes.load(mo),   counters.syscalls.load(mo), counters.transactions.load(mo),
+                 counters.sleptNs.load(mo), counters.busNs.load(mo),    counters.statusReads.load(mo),
+                 counters.retries.load(mo), counters.errors.load(mo) };
+    }
+
+    void LcdDriver::resetStats(void) const noexcept {
+        for(auto* counter : { &counters.bytes,   &counters.syscalls, &counters.transactions,
+                              &counters.sleptNs, &counters.busNs,    &counters.statusReads,
+                              &counters.retries, &counters.errors })
+            counter->store(0, std::memory_order_relaxed);
+    }
+
+    void LcdDriver::setRetry(unsigned int attempts, unsigned long backoffNs) noexcept {
+        retryLimit     = attempts;
+        retryBackoffNs = backoffNs;
+    }
+
+    void LcdDriver::setRecorder(std::shared_ptr<trace::TraceWriter> rec) noexcept {
+        recorder = std::move(rec);
+    }
+
+    void LcdDriver::setBusyPolling(bool on, unsigned long timeoutNs) noexcept {
+        pollBusy      = on && bus->canRead();
+        pollTimeoutNs = timeoutNs;
+    }
+
+    bool LcdDriver::isBusyPolling(void) const noexcept {
+        return pollBusy;
+    }
+
+    void LcdDriver::setTiming(const TimingProfile& prof) noexcept {
+        timing = prof;
+    }
+
+    const TimingProfile& LcdDriver::getTiming(void) const noexcept {
+        return timing;
+    }
+
+    uint64_t LcdDriver::getSleptNs(void) const noexcept {
+        return pacer.getSleptNs();
+    }
+
+    size_t LcdDriver::getRows(void) const noexcept {
+        return rows;
+    }
+
+    size_t LcdDriver::getColumns(void) const noexcept {
+        return columns;
+    }
+
+    int parseAddress(const string& text) anyexcept {
+        const bool isHex { text.size() > 2 && text[0] == '0' && (text[1] == 'x' || text[1] == 'X') };
+        return std::stoi(text, nullptr, isHex ? 16 : 10);
     }
 
 }
\ No newline at end of file
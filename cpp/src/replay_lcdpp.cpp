@@ -0,0 +1,191 @@
+/*
+# -----------------------------------------------------------------
+# simple_lcd - a command line tools to print message using Hitachi  
+#              HD44780 LCDs connected over I2C on Linux.                   
+# Copyright (C) 2020  Gabriele Bonacini
+#
+# This program is free software for no profit use; you can redistribute
+# it and/or modify it under the terms of the GNU General Public License
+# as published by the Free Software Foundation; either version 2 of
+# the License, or (at your option) any later version.
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+# You should have received a copy of the GNU General Public License
+# along with this program; if not, write to the Free Software Foundation,
+# Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301  USA
+# -----------------------------------------------------------------
+*/
+
+#include <time.h>
+
+#include <string>
+#include <memory>
+#include <iomanip>
+
+#include <lcd.hpp>
+#include <lcdRecord.hpp>
+#include <lcdEmulator.hpp>
+#include <parseCmdLine.hpp>
+
+using lcd_hitachi_driver::Delay;
+using lcd_hitachi_driver::TimingProfile;
+using lcd_hitachi_driver::Pacer;
+using lcd_hitachi_driver::Transport;
+using lcd_hitachi_driver::Hd44780Emulator;
+using lcd_hitachi_driver::parseAddress;
+namespace trace = lcd_hitachi_driver::trace;
+using parcmdline::ParseCmdLine;
+using std::cout;
+using std::cerr;
+using std::endl;
+using std::string;
+using std::stoi;
+using std::unique_ptr;
+using std::make_unique;
+
+void usage(char* pname);
+
+namespace {
+    const uint64_t  NS_PER_SEC      { 1000000000ULL };
+
+    uint64_t nowNs(void){
+        struct timespec now;
+        clock_gettime(CLOCK_MONOTONIC, &now);
+        return static_cast<uint64_t>(now.tv_sec) * NS_PER_SEC + static_cast<uint64_t>(now.tv_nsec);
+    }
+
+    void sleepUntil(uint64_t ns){
+        struct timespec deadline { static_cast<time_t>(ns / NS_PER_SEC), static_cast<long>(ns % NS_PER_SEC) };
+        while(clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &deadline, nullptr) == EINTR)
+            ;
+    }
+}
+
+int main(int argc, char** argv){
+    string               dev     { "/dev/i2c-1" },
+                         path    { "" },
+                         profile { "datasheet" },
+                         mode    { "original" },
+                         backend { "emulator" };
+	int                  addr    { 0x27 };
+    size_t               maxRows { 4 },
+                         maxCols { 16 };
+    bool                 verbose { false };
+
+    constexpr char    flags[]    { "f:m:B:d:a:T:R:c:vh" };
+    ParseCmdLine pcl(argc, argv, flags);
+    if(pcl.getErrorState()){
+        string exitMsg{string("Invalid  parameter or value").append(pcl.getErrorMsg())};
+        cerr << exitMsg << "\n";
+        usage(argv[0]);
+    }
+
+    if(pcl.isSet('h') || !pcl.isSet('f'))
+        usage(argv[0]);
+    path = pcl.getValue('f');
+
+    if(pcl.isSet('m') ) 
+        mode = pcl.getValue('m');
+    if(mode != "original" && mode != "max" && mode != "profile")
+        usage(argv[0]);
+
+    if(pcl.isSet('B') ) 
+        backend = pcl.getValue('B');
+
+    if(pcl.isSet('d') ) 
+        dev = pcl.getValue('d');
+
+    if(pcl.isSet('a') ) 
+        addr = parseAddress(pcl.getValue('a'));
+
+    if(pcl.isSet('T') ) 
+        profile = pcl.getValue('T');
+
+    if(pcl.isSet('R') ) 
+        maxRows = stoi(pcl.getValue('R'));
+    if(maxRows != 1 && maxRows != 2 && maxRows != 4)
+        usage(argv[0]);
+
+    if(pcl.isSet('c') ) 
+        maxCols = stoi(pcl.getValue('c'));
+    if(maxCols < 16 || maxCols >80)
+        usage(argv[0]);
+
+    if(pcl.isSet('v') ) 
+        verbose = true;
+
+    try{
+        TimingProfile           timing   { TimingProfile::byName(profile) };
+        trace::TraceReader      reader(path);
+        trace::Event            event;
+        Hd44780Emulator*        emulator { nullptr };
+        unique_ptr<Transport>   bus;
+        Pacer                   pacer;
+        size_t                  events   { 0 },
+                                skipped  { 0 },
+                                bytes    { 0 };
+
+        if(backend == "emulator"){
+            auto emu { make_unique<Hd44780Emulator>(maxRows, maxCols, timing) };
+            emulator = emu.get();
+            bus      = std::move(emu);
+        }else{
+            bus      = Transport::byName(backend, dev, addr);
+        }
+
+        // original: the recorded gaps are kept; max: back to back, the panel is
+        // likely to miss instructions; profile: every transaction waits what the
+        // -T profile gives to the Delay class it was recorded with.
+        uint64_t start { nowNs() };
+        while(reader.next(event)){
+            // Busy flag reads answer the state of the recorded panel, not of
+            // this one: they aren't replayed.
+            if(event.read){
+                ++skipped;
+                continue;
+            }
+
+            if(mode == "original")
+                sleepUntil(start + event.ns);
+            else if(mode == "profile")
+                pacer.waitReady();
+
+            bus->send(event.bytes.data(), event.bytes.size());
+            if(mode == "profile" && event.delay != trace::NO_DELAY)
+                pacer.arm(timing.delay(static_cast<Delay>(event.delay)));
+
+            ++events;
+            bytes += event.bytes.size();
+            if(verbose)
+                cout << std::setw(12) << event.ns << " " << std::setw(10) << trace::opName(event.op)
+                     << " " << event.bytes.size() << " bytes" << endl;
+        }
+        uint64_t wall { nowNs() - start };
+
+        cout << "replayed " << events << " transactions, " << bytes << " bytes, "
+             << skipped << " reads skipped, in " << wall / 1000 << " us (" << mode << ")" << endl;
+        if(emulator != nullptr)
+            emulator->report(cout);
+    } catch (const std::exception& ex) {
+        cerr << ex.what() << "\nProgram exits with errors\n";
+        exit(1);
+    }
+
+    return 0;
+}
+
+void usage(char* pname){
+    cerr << "Usage:\n" << pname << " -f trace [ -m mode ] [ -B backend ] [ -d device ] [ -a hex_address ] [ -T timing ] [-R rowmax] [-c colmax] [-v]\n"
+         << "\n* trace is a binary trace recorded with simple_lcdpp -w or LcdDriver::setRecorder()\n"
+         << "* mode can be 'original' (recorded pace), 'max' (no waits) or 'profile' (-T timing), default original\n"
+         << "* backend can be 'emulator', or a simple_lcdpp one: 'auto', 'i2c-dev', 'rdwr', 'smbus', 'smbus-byte', 'trace' or 'mock', default emulator\n"
+         << "* timing can be 'datasheet', 'conservative' or a profile file path, default datasheet\n"
+         << "* row_max and col_max give the emulated geometry, default 4 and 16\n"
+         << "* -v prints every transaction\n"
+         << "\nExample: \n"
+         << " replay_lcdpp -f field.lct -m max -R4 -c20\n"
+         << "\nplays a trace at full speed on an emulated 4x20 panel and reports the timing violations. \n";
+    exit(1);
+}
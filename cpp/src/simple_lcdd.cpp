@@ -0,0 +1,279 @@
+/*
+# -----------------------------------------------------------------
+# simple_lcd - a command line tools to print message using Hitachi  
+#              HD44780 LCDs connected over I2C on Linux.                   
+# Copyright (C) 2020  Gabriele Bonacini
+#
+# This program is free software for no profit use; you can redistribute
+# it and/or modify it under the terms of the GNU General Public License
+# as published by the Free Software Foundation; either version 2 of
+# the License, or (at your option) any later version.
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+# You should have received a copy of the GNU General Public License
+# along with this program; if not, write to the Free Software Foundation,
+# Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301  USA
+# -----------------------------------------------------------------
+*/
+
+#include <string>
+#include <vector>
+
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <poll.h>
+#include <signal.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+
+#include <lcd.hpp>
+#include <lcdProtocol.hpp>
+#include <parseCmdLine.hpp>
+
+using lcd_hitachi_driver::LcdDriver;
+using lcd_hitachi_driver::parseAddress;
+using lcd_hitachi_driver::TimingProfile;
+using lcd_hitachi_driver::Transport;
+using lcd_hitachi_driver::protocol::Message;
+using lcd_hitachi_driver::protocol::MsgType;
+using lcd_hitachi_driver::protocol::readMessage;
+using lcd_hitachi_driver::protocol::writeMessage;
+using parcmdline::ParseCmdLine;
+using std::cerr;
+using std::string;
+using std::vector;
+using std::stoi;
+
+namespace protocol = lcd_hitachi_driver::protocol;
+
+void usage(char* pname);
+
+namespace {
+    volatile sig_atomic_t  stopRequest { 0 };
+
+    void onSignal(int){
+        stopRequest = 1;
+    }
+
+    int listenOn(const string& path){
+        struct sockaddr_un  addr;
+        if(path.size() >= sizeof(addr.sun_path)){
+            cerr << "Socket path too long.\n";
+            return -1;
+        }
+
+        memset(&addr, 0, sizeof(addr));
+        addr.sun_family = AF_UNIX;
+        memcpy(addr.sun_path, path.c_str(), path.size());
+
+        int fd { socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0) };
+        if(fd < 0){
+            cerr << "Can't create socket: " << strerror(errno) << "\n";
+            return -1;
+        }
+
+        unlink(path.c_str());
+        if(bind(fd, reinterpret_cast<struct sockaddr*>(&addr), sizeof(addr)) < 0 ||
+           chmod(path.c_str(), 0660) < 0 || listen(fd, 16) < 0){
+            cerr << "Can't listen on " << path << ": " << strerror(errno) << "\n";
+            close(fd);
+            return -1;
+        }
+
+        return fd;
+    }
+
+    Message dispatch(const LcdDriver& lcdDriver, const Message& req, size_t maxRows){
+        Message reply { MsgType::REPLY, protocol::STATUS_OK, 0, "" };
+
+        try{
+            switch(req.type){
+                case MsgType::INIT:
+                    lcdDriver.init();
+                break;
+                case MsgType::WRITE_LINE:
+                    if(req.row < 1 || req.row > maxRows)
+                        return { MsgType::REPLY, protocol::STATUS_BAD_REQ, 0, "Invalid row number." };
+                    lcdDriver.writeLine(req.payload, req.row, (req.flags & protocol::FLAG_CLEAN) != 0);
+                break;
+                case MsgType::WRITE_FRAME:
+                {
+                    vector<string>  frame;
+                    size_t          start { 0 };
+                    while(true){
+                        size_t end { req.payload.find('\n', start) };
+                        frame.push_back(req.payload.substr(start, end == string::npos ? string::npos : end - start));
+                        if(end == string::npos)
+                            break;
+                        start = end + 1;
+                    }
+                    if(frame.size() > maxRows)
+                        return { MsgType::REPLY, protocol::STATUS_BAD_REQ, 0, "Too many rows." };
+                    lcdDriver.writeFrame(frame);
+                }
+                break;
+                default:
+                    return { MsgType::REPLY, protocol::STATUS_BAD_REQ, 0, "Unknown request." };
+            }
+        } catch (const std::exception& ex) {
+            return { MsgType::REPLY, protocol::STATUS_BUS_ERROR, 0, ex.what() };
+        } catch (...) {
+            return { MsgType::REPLY, protocol::STATUS_BUS_ERROR, 0, "Bus error." };
+        }
+
+        return reply;
+    }
+}
+
+int main(int argc, char** argv){
+    bool                 init     { false };
+    string               dev      { "/dev/i2c-1" },
+                         profile  { "conservative" },
+                         sockPath { protocol::DEFAULT_SOCKET },
+                         backend  { "auto" };
+	int                  addr     { 0x27 },
+                         pollUs   { 0 };
+    size_t               maxRows  { 4 },
+                         maxCols  { 16 };
+
+    constexpr char    flags[]    { "R:c:d:a:T:S:B:P:ih" };
+    ParseCmdLine pcl(argc, argv, flags);
+    if(pcl.getErrorState()){
+        string exitMsg{string("Invalid  parameter or value").append(pcl.getErrorMsg())};
+        cerr << exitMsg << "\n";
+        usage(argv[0]);
+    }
+
+    if(pcl.isSet('h'))
+        usage(argv[0]);
+
+    if(pcl.isSet('d') ) 
+        dev = pcl.getValue('d');
+
+    if(pcl.isSet('R') ) 
+        maxRows = stoi(pcl.getValue('R'));
+    if(maxRows != 1 && maxRows != 2 && maxRows != 4)
+        usage(argv[0]);
+
+    if(pcl.isSet('c') ) 
+        maxCols = stoi(pcl.getValue('c'));
+    if(maxCols < 16 || maxCols >80)
+        usage(argv[0]);
+
+    if(pcl.isSet('a') ) 
+        addr = parseAddress(pcl.getValue('a'));
+
+    if(pcl.isSet('T') ) 
+        profile = pcl.getValue('T');
+
+    if(pcl.isSet('S') ) 
+        sockPath = pcl.getValue('S');
+
+    if(pcl.isSet('B') ) 
+        backend = pcl.getValue('B');
+
+    if(pcl.isSet('P') ) 
+        pollUs = stoi(pcl.getValue('P'));
+    if(pollUs < 0)
+        usage(argv[0]);
+
+    if(pcl.isSet('i') ) 
+        init = true;
+
+    struct sigaction  sa;
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = onSignal;
+    sigaction(SIGINT,  &sa, nullptr);
+    sigaction(SIGTERM, &sa, nullptr);
+    signal(SIGPIPE, SIG_IGN);
+
+    try{
+        LcdDriver lcdDriver(Transport::byName(backend, dev, addr), maxRows, maxCols);
+        lcdDriver.setTiming(TimingProfile::byName(profile));
+        if(pollUs > 0)
+            lcdDriver.setBusyPolling(true, static_cast<unsigned long>(pollUs) * 1000);
+        if(init)
+            lcdDriver.init();
+
+        int fdListen { listenOn(sockPath) };
+        if(fdListen < 0)
+            exit(1);
+
+        // The bus is owned here for the daemon's whole life: clients pay only
+        // the socket round trip and the bus time of their own update.
+        vector<struct pollfd>  fds { { fdListen, POLLIN, 0 } };
+        while(stopRequest == 0){
+            if(poll(fds.data(), fds.size(), -1) < 0){
+                if(errno == EINTR)
+                    continue;
+                cerr << "poll() failed: " << strerror(errno) << "\n";
+                break;
+            }
+
+            for(size_t idx { fds.size() - 1 }; idx > 0; --idx){
+                if(fds[idx].revents == 0)
+                    continue;
+
+                Message  req;
+                bool     keep { false };
+                try{
+                    if(readMessage(fds[idx].fd, req)){
+                        writeMessage(fds[idx].fd, dispatch(lcdDriver, req, maxRows));
+                        keep = true;
+                    }
+                } catch (const std::exception& ex) {
+                    cerr << "Client dropped: " << ex.what() << "\n";
+                }
+
+                if(!keep){
+                    close(fds[idx].fd);
+                    fds.erase(fds.begin() + static_cast<long>(idx));
+                }
+            }
+
+            if(fds[0].revents & POLLIN){
+                int fdClient { accept4(fdListen, nullptr, nullptr, SOCK_CLOEXEC) };
+                if(fdClient >= 0){
+                    // A stalled client must not hold the panel hostage, neither
+                    // sending half a request nor leaving its reply unread.
+                    struct timeval tmout { 1, 0 };
+                    setsockopt(fdClient, SOL_SOCKET, SO_RCVTIMEO, &tmout, sizeof(tmout));
+                    setsockopt(fdClient, SOL_SOCKET, SO_SNDTIMEO, &tmout, sizeof(tmout));
+                    fds.push_back({ fdClient, POLLIN, 0 });
+                }
+            }
+        }
+
+        for(auto& pfd : fds)
+            close(pfd.fd);
+        unlink(sockPath.c_str());
+    } catch (const std::exception& ex) {
+        cerr << ex.what() << "\nProgram exits with errors\n";
+        exit(1);
+    } catch (...) {
+        cerr << "Program exits with errors\n";
+        exit(1);
+    }
+
+    return 0;
+}
+
+void usage(char* pname){
+    cerr << "Usage:\n" << pname << " [-R rowmax] [-c colmax] [-i] [ -d device ] [ -a hex_address ] [ -T timing ] [ -S socket ] [ -B backend ] [ -P poll_timeout ]\n"
+         << "\n* row_max can be 1 , 2 or 4, default 4\n"
+         << "* col_max between 16 and 80, default 16\n"
+         << "* timing can be 'datasheet', 'conservative' or a profile file path, default conservative\n"
+         << "* socket default " << protocol::DEFAULT_SOCKET << "\n"
+         << "* backend can be 'auto', 'i2c-dev', 'rdwr', 'smbus', 'smbus-byte', 'trace' (device is the trace file) or 'mock', default auto\n"
+         << "* poll_timeout in microseconds enables busy flag polling, default off\n"
+         << "\nExample: \n"
+         << " sudo simple_lcdd -R4 -c16 -i & \n"
+         << " simple_lcdpp -r1 -t'hello world!' \n"
+         << "\nkeeps a 4x16 display open and serves simple_lcdpp requests. \n";
+    exit(1);
+}
@@ -25,32 +25,80 @@
 #include <unistd.h>
 #include <sys/sysmacros.h>
 
+#include <memory>
+#include <vector>
+#include <fstream>
+#include <functional>
+#include <thread>
+#include <chrono>
+
 #include <lcd.hpp>
+#include <lcdProtocol.hpp>
 #include <parseCmdLine.hpp>
 
 using lcd_hitachi_driver::LcdDriver;
+using lcd_hitachi_driver::parseAddress;
+using lcd_hitachi_driver::TimingProfile;
+using lcd_hitachi_driver::Transport;
+using lcd_hitachi_driver::protocol::LcdClient;
 using parcmdline::ParseCmdLine;
 using std::cerr;
 using std::endl;
 using std::string;
 using std::stoi;
+using std::unique_ptr;
+using std::make_unique;
+using std::vector;
+using std::function;
+using std::ifstream;
+
+namespace protocol = lcd_hitachi_driver::protocol;
+
+// Where records end up: the driver, or a running simple_lcdd.
+struct Sink {
+    function<void(void)>                         init;
+    function<void(const string&, unsigned int)>  line;
+    function<void(const vector<string>&)>        frame;
+};
 
 void usage(char* pname);
 void nodev(void);
+void printStats(const LcdDriver& driver);
+void stream(const string& source, const Sink& sink, size_t rows);
+void pager(const vector<string>& lines, const Sink& sink, size_t rows, size_t cols, double wait);
+vector<string> readAll(const string& source);
 
 int main(int argc, char** argv){
     bool                 init    { false };
     string               dev     { "/dev/i2c-1" },
-                         text    { "" };
+                         text    { "" },
+                         profile { "conservative" },
+                         sockPath{ protocol::DEFAULT_SOCKET },
+                         backend { "auto" },
+                         source  { "" },
+                         record  { "" };
     const unsigned int   majorno { 89 };
 	int                  addr    { 0x27 },
-                         row     { 1 };
+                         row     { 1 },
+                         pollUs  { 0 };
     size_t               maxRows { 4 },
                          maxCols { 16 };
+    double               pageWait{ 0 };
     struct stat          sbuf;
 
-    constexpr char    flags[]    { "R:c:d:a:t:r:ih" };
-    ParseCmdLine pcl(argc, argv, flags);
+    constexpr char    flags[]    { "R:c:d:a:t:r:T:S:B:P:s:p:w:ih" };
+    // --stats is the only long option: taken out before the short ones are parsed.
+    bool              dumpStats  { false };
+    vector<char*>     args;
+    for(int idx { 0 }; idx < argc; ++idx){
+        if(string(argv[idx]) == "--stats")
+            dumpStats = true;
+        else
+            args.push_back(argv[idx]);
+    }
+    args.push_back(nullptr);
+
+    ParseCmdLine pcl(static_cast<int>(args.size() - 1), args.data(), flags);
     if(pcl.getErrorState()){
         string exitMsg{string("Invalid  parameter or value").append(pcl.getErrorMsg())};
         cerr << exitMsg << "\n";
@@ -60,10 +108,25 @@ int main(int argc, char** argv){
     if(pcl.isSet('h'))
         usage(argv[0]);
 
-    if(!pcl.isSet('t') || !pcl.isSet('r')) 
+    if(pcl.isSet('s') ) 
+        source = pcl.getValue('s');
+
+    if(pcl.isSet('w') ) 
+        record = pcl.getValue('w');
+
+    if(pcl.isSet('p') ) 
+        pageWait = std::stod(pcl.getValue('p'));
+    if(pageWait < 0)
+        usage(argv[0]);
+
+    // Streaming reads its records from -s, the pager its text from -s or -t;
+    // otherwise one -t string goes to the -r row.
+    if(source.empty() && (!pcl.isSet('t') || (!pcl.isSet('r') && !pcl.isSet('p'))))
         usage(argv[0]);
-    text = pcl.getValue('t');
-    row = stoi(pcl.getValue('r'));
+    if(pcl.isSet('t') ) 
+        text = pcl.getValue('t');
+    if(pcl.isSet('r') ) 
+        row = stoi(pcl.getValue('r'));
 
     if(pcl.isSet('d') ) 
         dev = pcl.getValue('d');
@@ -72,41 +135,219 @@ int main(int argc, char** argv){
         maxRows = stoi(pcl.getValue('R'));
     if(maxRows != 1 && maxRows != 2 && maxRows != 4)
         usage(argv[0]);
+    if(row < 1 || static_cast<size_t>(row) > maxRows)
+        usage(argv[0]);
 
     if(pcl.isSet('c') ) 
         maxCols = stoi(pcl.getValue('c'));
     if(maxCols < 16 || maxCols >80)
         usage(argv[0]);
 
-    if(stat(dev.c_str(), &sbuf) == -1)    
-        nodev();
-
-    if(major(sbuf.st_dev != majorno)) 
-        nodev();
-
     if(pcl.isSet('a') ) 
-        addr = stoi(pcl.getValue('a'));
+        addr = parseAddress(pcl.getValue('a'));
 
     if(pcl.isSet('i') ) 
         init = true;
 
-    try{
-        LcdDriver lcdDriver(addr, maxRows, maxCols, dev);
+    if(pcl.isSet('T') ) 
+        profile = pcl.getValue('T');
+
+    if(pcl.isSet('S') ) 
+        sockPath = pcl.getValue('S');
+
+    if(pcl.isSet('B') ) 
+        backend = pcl.getValue('B');
+
+    if(pcl.isSet('P') ) 
+        pollUs = stoi(pcl.getValue('P'));
+    if(pollUs < 0)
+        usage(argv[0]);
+
+    auto run = [&](const Sink& sink){
         if(init)
-            lcdDriver.init();
-        lcdDriver.writeLine(text, row, true);
+            sink.init();
+        if(pcl.isSet('p'))
+            pager(source.empty() ? vector<string>{ text } : readAll(source), sink, maxRows, maxCols, pageWait);
+        else if(!source.empty())
+            stream(source, sink, maxRows);
+        else
+            sink.line(text, static_cast<unsigned int>(row));
+    };
+
+    // A running simple_lcdd owns the bus: hand the request over to it. Without
+    // -S a missing daemon isn't an error, the display is driven directly, and
+    // options naming a device mean that device, not the daemon's one.
+    const bool devOpts { pcl.isSet('d') || pcl.isSet('a') || pcl.isSet('R') || pcl.isSet('c') ||
+                         pcl.isSet('T') || pcl.isSet('B') || pcl.isSet('P') };
+    if(pcl.isSet('S') || (!devOpts && access(sockPath.c_str(), F_OK) == 0)){
+        if(!record.empty() || dumpStats){
+            cerr << "-w and --stats need the bus, owned by simple_lcdd: run them without the daemon\n";
+            exit(1);
+        }
+
+        unique_ptr<LcdClient> client;
+        try{
+            client = make_unique<LcdClient>(sockPath);
+        } catch (const std::exception& ex) {
+            if(pcl.isSet('S')){
+                cerr << ex.what() << "\nProgram exits with errors\n";
+                exit(1);
+            }
+        }
+
+        if(client){
+            LcdClient* cl { client.get() };
+            Sink       sink { [cl](){ cl->init(); },
+                              [cl](const string& msg, unsigned int rw){ cl->writeLine(msg, rw, true); },
+                              [cl](const vector<string>& frame){ cl->writeFrame(frame); } };
+            try{
+                run(sink);
+            } catch (const std::exception& ex) {
+                cerr << ex.what() << "\nProgram exits with errors\n";
+                exit(1);
+            }
+            return 0;
+        }
+    }
+
+    if(backend != "trace" && backend != "mock"){
+        if(stat(dev.c_str(), &sbuf) == -1)    
+            nodev();
+
+        if(major(sbuf.st_dev != majorno)) 
+            nodev();
+    }
+
+    unique_ptr<LcdDriver> lcdDriver;
+    try{
+        lcdDriver = make_unique<LcdDriver>(Transport::byName(backend, dev, addr), maxRows, maxCols);
+        lcdDriver->setTiming(TimingProfile::byName(profile));
+        if(pollUs > 0)
+            lcdDriver->setBusyPolling(true, static_cast<unsigned long>(pollUs) * 1000);
+        if(!record.empty())
+            lcdDriver->setRecorder(std::make_shared<lcd_hitachi_driver::trace::TraceWriter>(record));
+        LcdDriver* drv  { lcdDriver.get() };
+        Sink       sink { [drv](){ drv->init(); },
+                          [drv](const string& msg, unsigned int rw){ drv->writeLine(msg, rw, true); },
+                          [drv](const vector<string>& frame){ drv->writeFrame(frame); } };
+        run(sink);
+    } catch (const std::exception& ex) {
+        cerr << ex.what() << "\nProgram exits with errors\n";
+        if(dumpStats && lcdDriver)
+            printStats(*lcdDriver);
+        exit(1);
     } catch (...) {
         cerr << "Program exits with errors\n";
+        if(dumpStats && lcdDriver)
+            printStats(*lcdDriver);
         exit(1);
     }
 
+    if(dumpStats)
+        printStats(*lcdDriver);
+
     return 0;
 }
 
+void printStats(const LcdDriver& driver){
+    const auto st { driver.stats() };
+    std::cout << "{\"bytes\": "         << st.bytes
+              << ", \"syscalls\": "     << st.syscalls
+              << ", \"transactions\": " << st.transactions
+              << ", \"slept_ns\": "     << st.sleptNs
+              << ", \"bus_ns\": "       << st.busNs
+              << ", \"status_reads\": " << st.statusReads
+              << ", \"retries\": "      << st.retries
+              << ", \"errors\": "       << st.errors << "}" << endl;
+}
+
+void stream(const string& source, const Sink& sink, size_t rows){
+    // Records are lines: "N:text" writes row N, any other line scrolls the
+    // screen up and appears on the last row. A FIFO is reopened when its
+    // writer goes away, so the bus stays open across producers; lstat keeps
+    // /dev/stdin, a link to an anonymous pipe, out of this.
+    vector<string>  screen(rows);
+    struct stat     sbuf;
+    bool            fifo  { lstat(source.c_str(), &sbuf) == 0 && S_ISFIFO(sbuf.st_mode) };
+
+    do{
+        ifstream  in(source);
+        string    record;
+        if(!in)
+            throw std::runtime_error("Can't open stream source: " + source);
+
+        while(getline(in, record)){
+            if(!record.empty() && record.back() == '\r')
+                record.pop_back();
+
+            size_t  sep   { record.find(':') };
+            size_t  rw    { 0 };
+            if(sep > 0 && sep <= 2 && sep != string::npos &&
+               record.find_first_not_of("0123456789") == sep)
+                rw = static_cast<size_t>(stoi(record.substr(0, sep)));
+
+            if(rw >= 1 && rw <= rows){
+                screen[rw - 1] = record.substr(sep + 1);
+                sink.line(screen[rw - 1], static_cast<unsigned int>(rw));
+            }else{
+                screen.erase(screen.begin());
+                screen.push_back(record);
+                sink.frame(screen);
+            }
+        }
+    }while(fifo);
+}
+
+void pager(const vector<string>& lines, const Sink& sink, size_t rows, size_t cols, double wait){
+    // Like LcdPrintHelper.page of the Python version: the text is split into
+    // rows of cols characters, then shown rows at a time, wait seconds apart.
+    vector<string>  split;
+    for(const auto& line : lines){
+        if(line.empty())
+            split.push_back(line);
+        for(size_t start { 0 }; start < line.size(); start += cols)
+            split.push_back(line.substr(start, cols));
+    }
+
+    for(size_t start { 0 }; start < split.size(); start += rows){
+        if(start > 0)
+            std::this_thread::sleep_for(std::chrono::duration<double>(wait));
+
+        vector<string>  page(split.begin() + static_cast<long>(start),
+                             split.begin() + static_cast<long>(start + rows < split.size() ? start + rows : split.size()));
+        page.resize(rows);
+        sink.frame(page);
+    }
+}
+
+vector<string> readAll(const string& source){
+    ifstream        in(source);
+    vector<string>  lines;
+    string          line;
+
+    if(!in)
+        throw std::runtime_error("Can't open stream source: " + source);
+
+    while(getline(in, line)){
+        if(!line.empty() && line.back() == '\r')
+            line.pop_back();
+        lines.push_back(line);
+    }
+    return lines;
+}
+
 void usage(char* pname){
-    cerr << "Usage:\n" << pname << " [-R rowmax] [-c colmax] [ -t text ] [ -r row_number ] [-i] [ -d device ] [ -a hex_address ]\n"
+    cerr << "Usage:\n" << pname << " [-R rowmax] [-c colmax] [ -t text ] [ -r row_number ] [-i] [ -d device ] [ -a hex_address ] [ -T timing ] [ -S socket ] [ -B backend ] [ -P poll_timeout ] [ -s source ] [ -p seconds ] [ -w trace ] [ --stats ]\n"
          << "\n* row_max can be 1 , 2 or 4, default 4\n"
          << "* col_max between 16 and 80, default 16\n"
+         << "* timing can be 'datasheet', 'conservative' or a profile file path, default conservative\n"
+         << "* socket of a running simple_lcdd, default " << protocol::DEFAULT_SOCKET << " when present and no device option is given\n"
+         << "* backend can be 'auto', 'i2c-dev', 'rdwr', 'smbus', 'smbus-byte', 'trace' (device is the trace file) or 'mock', default auto\n"
+         << "* poll_timeout in microseconds enables busy flag polling, default off\n"
+         << "* source of newline separated records, 'row:text' or text scrolling up; /dev/stdin for standard input\n"
+         << "* seconds between pages: the text of -t or -s is paged over the whole display\n"
+         << "* trace records the bus traffic in a binary file, see replay_lcdpp\n"
+         << "* --stats prints the driver counters as JSON on exit\n"
          << "\nExample: \n"
          << " sudo simple_lcdpp -R4 -c16 -r1 -t'hello world!' \n"
          << "\nwrites 'hello world!' on the first row of a 4x16 display. \n";
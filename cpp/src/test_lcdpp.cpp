@@ -0,0 +1,522 @@
+/*
+# -----------------------------------------------------------------
+# simple_lcd - a command line tools to print message using Hitachi  
+#              HD44780 LCDs connected over I2C on Linux.                   
+# Copyright (C) 2020  Gabriele Bonacini
+#
+# This program is free software for no profit use; you can redistribute
+# it and/or modify it under the terms of the GNU General Public License
+# as published by the Free Software Foundation; either version 2 of
+# the License, or (at your option) any later version.
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+# You should have received a copy of the GNU General Public License
+# along with this program; if not, write to the Free Software Foundation,
+# Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301  USA
+# -----------------------------------------------------------------
+*/
+
+#include <cerrno>
+#include <cstdlib>
+#include <unistd.h>
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <functional>
+
+#include <lcd.hpp>
+#include <lcdEmulator.hpp>
+#include <lcdAsync.hpp>
+#include <lcdManager.hpp>
+#include <lcdFixed.hpp>
+#include <lcdCoalesce.hpp>
+#include <lcdMarquee.hpp>
+#include <lcdGlyph.hpp>
+#include <lcdLayout.hpp>
+#include <lcdCApi.h>
+
+using lcd_hitachi_driver::LcdDriver;
+using lcd_hitachi_driver::Hd44780Emulator;
+using lcd_hitachi_driver::Transport;
+using lcd_hitachi_driver::BusError;
+using lcd_hitachi_driver::AsyncLcdDriver;
+using lcd_hitachi_driver::Backpressure;
+using lcd_hitachi_driver::DisplayManager;
+using lcd_hitachi_driver::FixedLcdDriver;
+using lcd_hitachi_driver::CoalescingLcdDriver;
+using lcd_hitachi_driver::Marquee;
+using lcd_hitachi_driver::GlyphCache;
+using lcd_hitachi_driver::Layout;
+using std::cout;
+using std::string;
+using std::vector;
+using std::unique_ptr;
+using std::make_unique;
+using std::function;
+
+// The drivers against the emulated controller: every case checks the text the
+// panel ends up showing and that no instruction arrived before the previous
+// one had completed.
+
+namespace {
+    const size_t  ROWS { 4 },
+                  COLS { 20 };
+
+    // Forwards to the emulator, which outlives the driver owning the transport.
+    // Once armed, the next transfer delivers only its first cutLen bytes and
+    // fails like a NAK on the wire.
+    class EmulatorBus : public Transport {
+        public:
+            explicit EmulatorBus(Hd44780Emulator& emu) noexcept
+              : emulator{emu}
+            {}
+
+            void send(const unsigned char* data, size_t len) override{
+                if(armed && len > cutLen){
+                    armed = false;
+                    emulator.send(data, cutLen);
+                    sent += cutLen;
+                    throw BusError(EREMOTEIO, "Cut transfer.");
+                }
+                emulator.send(data, len);
+                sent += len;
+            }
+
+            bool canRead(void) const noexcept override{
+                return emulator.canRead();
+            }
+
+            void sendRecv(const unsigned char* out, size_t outLen,
+                          unsigned char* in, size_t inLen) override{
+                emulator.sendRecv(out, outLen, in, inLen);
+                sent += outLen;
+            }
+
+            size_t getSent(void) const noexcept{
+                return sent;
+            }
+
+            void cutNext(size_t len) noexcept{
+                armed  = true;
+                cutLen = len;
+            }
+
+        private:
+            Hd44780Emulator&  emulator;
+            size_t            sent   { 0 };
+            bool              armed  { false };
+            size_t            cutLen { 0 };
+    };
+
+    struct Panel {
+        unique_ptr<Hd44780Emulator>  emulator;
+        EmulatorBus*                 bus;          // owned by the driver
+        unique_ptr<LcdDriver>        driver;       // released before the emulator
+    };
+
+    Panel makePanel(void){
+        Panel pnl;
+        pnl.emulator = make_unique<Hd44780Emulator>(ROWS, COLS);
+        auto bus     { make_unique<EmulatorBus>(*pnl.emulator) };
+        pnl.bus      = bus.get();
+        pnl.driver   = make_unique<LcdDriver>(std::move(bus), ROWS, COLS);
+        return pnl;
+    }
+
+    string pad(const string& text, size_t cols){
+        return text.size() < cols ? text + string(cols - text.size(), ' ') : text.substr(0, cols);
+    }
+
+    bool expect(const Hd44780Emulator& emu, const vector<string>& rows, string& detail){
+        const vector<string> screen { emu.getScreen() };
+        for(size_t idx { 0 }; idx < screen.size(); ++idx){
+            const string want { pad(idx < rows.size() ? rows[idx] : "", screen[idx].size()) };
+            if(screen[idx] != want){
+                detail = "row " + std::to_string(idx + 1) + " is '" + screen[idx] + "', expected '" + want + "'";
+                return false;
+            }
+        }
+        if(!emu.getViolations().empty()){
+            detail = std::to_string(emu.getViolations().size()) + " timing violations";
+            return false;
+        }
+        return true;
+    }
+
+    bool expect(const Panel& pnl, const vector<string>& rows, string& detail){
+        return expect(*pnl.emulator, rows, detail);
+    }
+
+    bool testInit(string& detail){
+        Panel pnl { makePanel() };
+        pnl.driver->init();
+        if(!pnl.emulator->isFourBit() || !pnl.emulator->isDisplayOn()){
+            detail = "controller not in 4 bit mode with the display on";
+            return false;
+        }
+        return expect(pnl, {}, detail);
+    }
+
+    bool testWriteLine(string& detail){
+        Panel pnl { makePanel() };
+        pnl.driver->init();
+        pnl.driver->writeLine("hello world", 1, true);
+        pnl.driver->writeLine("second", 2, true);
+        pnl.driver->writeLine("hello there", 1, true);
+        pnl.driver->writeLine("XY", 2, false);
+        return expect(pnl, { "hello there", "XYcond" }, detail);
+    }
+
+    bool testWriteFrame(string& detail){
+        Panel pnl { makePanel() };
+        pnl.driver->init();
+        pnl.driver->writeFrame({ "one", "two", "three", "four" });
+        pnl.driver->writeFrame({ "one", "2", "three and more text to cut" });
+        return expect(pnl, { "one", "2", "three and more text ", "four" }, detail);
+    }
+
+    // With busy-flag polling every instruction waits for BF to drop instead
+    // of a timed delay: the polling must neither time out nor run early. The
+    // timeout is generous, a loaded machine may preempt the polling loop.
+    bool testBusyPolling(string& detail){
+        Panel pnl { makePanel() };
+        pnl.driver->setBusyPolling(true, 1000000000);
+        pnl.driver->init();
+        pnl.driver->writeFrame({ "polled", "busy flag" });
+        pnl.driver->writeLine("BUSY", 2, false);
+        if(!pnl.driver->isBusyPolling()){
+            detail = "busy flag polling fell back to timed delays";
+            return false;
+        }
+        return expect(pnl, { "polled", "BUSY flag" }, detail);
+    }
+
+    // The frame is cut at every nibble boundary of its first transfer: the
+    // controller is left anywhere inside an instruction and must be brought
+    // back before the frame is written again.
+    bool testRecovery(string& detail){
+        const vector<string> frame { "recovered", "after a", "cut", "transfer" };
+        for(size_t cut { 3 }; cut < 60; cut += 3){
+            Panel pnl { makePanel() };
+            pnl.driver->init();
+            pnl.bus->cutNext(cut);
+            pnl.driver->writeFrame(frame);
+            if(!expect(pnl, frame, detail)){
+                detail = "cut at byte " + std::to_string(cut) + ": " + detail;
+                return false;
+            }
+            if(pnl.driver->stats().retries == 0){
+                detail = "cut at byte " + std::to_string(cut) + ": no retry";
+                return false;
+            }
+        }
+        return true;
+    }
+
+    // A two slot queue overflows while the init is still on the bus: neither
+    // the init nor the partial write may be lost.
+    bool testAsyncDropOldest(string& detail){
+        Panel pnl { makePanel() };
+        {
+            AsyncLcdDriver async(std::move(pnl.driver), 2, Backpressure::DROP_OLDEST);
+            async.init();
+            async.writeLine("hello world", 1, true);
+            async.writeLine("second", 2, true);
+            async.writeLine("XY", 2, false);
+            async.writeLine("hello there", 1, true);
+            async.flush();
+        }
+        if(!pnl.emulator->isFourBit()){
+            detail = "controller not in 4 bit mode";
+            return false;
+        }
+        return expect(pnl, { "hello there", "XYcond" }, detail);
+    }
+
+    // Three panels, two of them sharing an adapter: each ends up with its own text.
+    bool testDisplayManager(string& detail){
+        vector<Panel> pnls;
+        for(size_t idx { 0 }; idx < 3; ++idx)
+            pnls.push_back(makePanel());
+        {
+            DisplayManager mgr;
+            mgr.addPanel("left",  "bus-a", std::move(pnls[0].driver));
+            mgr.addPanel("right", "bus-a", std::move(pnls[1].driver));
+            mgr.addPanel("far",   "bus-b", std::move(pnls[2].driver));
+            mgr.start();
+            mgr.initAll();
+            mgr.writeFrame("left", { "left panel", "row two" });
+            mgr.writeLine("right", "right panel", 3, true);
+            mgr.writeLine("far", "far panel", 1, true);
+            mgr.writeLine("left", "ROW", 2, false);
+            mgr.flush();
+            if(mgr.getBuses() != 2 || mgr.getPanels() != 3){
+                detail = "wrong bus or panel count";
+                return false;
+            }
+        }
+        const vector<vector<string>> want {
+            { "left panel", "ROW two" }, { "", "", "right panel" }, { "far panel" }
+        };
+        for(size_t idx { 0 }; idx < pnls.size(); ++idx)
+            if(!expect(pnls[idx], want[idx], detail)){
+                detail = "panel " + std::to_string(idx + 1) + ": " + detail;
+                return false;
+            }
+        return true;
+    }
+
+    // FixedLcdDriver drives the same emulator: the row addresses and the init
+    // bytes baked in at compile time must land where the runtime driver's do.
+    template<size_t R, size_t C>
+    bool checkFixed(const typename FixedLcdDriver<R, C>::Frame& frame,
+                    const vector<string>& want, string& detail){
+        Hd44780Emulator         emu(R, C);
+        FixedLcdDriver<R, C>    drv(make_unique<EmulatorBus>(emu));
+        drv.init();
+        drv.writeFrame(frame);
+        drv.template writeLine<1>("FIXED", false);
+        drv.writeLine("last row", R, true);
+        if(!emu.isFourBit() || !emu.isDisplayOn()){
+            detail = "controller not in 4 bit mode with the display on";
+            return false;
+        }
+        return expect(emu, want, detail);
+    }
+
+    bool testFixed4x20(string& detail){
+        return checkFixed<4, 20>({ "first row", "second row", "third row, longer than twenty", "fourth" },
+                                 { "FIXED row", "second row", "third row, longer th", "last row" }, detail);
+    }
+
+    bool testFixed2x16(string& detail){
+        return checkFixed<2, 16>({ "top line", "bottom line" }, { "FIXEDine", "last row" }, detail);
+    }
+
+    // A burst of writes far faster than the frame rate: intermediate versions
+    // are skipped, the last one of every cell still reaches the panel.
+    bool testCoalescing(string& detail){
+        Panel pnl { makePanel() };
+        {
+            CoalescingLcdDriver coal(std::move(pnl.driver), 50);
+            coal.init();
+            for(unsigned int count { 0 }; count < 200; ++count)
+                coal.writeLine("count " + std::to_string(count), 1, true);
+            coal.writeFrame({ "", "frame row", "third" });
+            coal.writeAt("AT", 3, 3);
+            coal.writeLine("count 199", 1, true);
+            coal.flush();
+            if(coal.getSuperseded() == 0){
+                detail = "no write was superseded";
+                return false;
+            }
+        }
+        return expect(pnl, { "count 199", "frame row", "thiAT" }, detail);
+    }
+
+    // Shifts and return home move the window, not DDRAM: once back home the
+    // rows already on the panel must not be sent again.
+    bool testMarquee(string& detail){
+        const string text { "0123456789abcdefghijklmnopqrstuvwxyzABCD" };
+        Panel   pnl { makePanel() };
+        Marquee mq  { *pnl.driver };
+        pnl.driver->init();
+        mq.load(text, 1);
+        for(size_t idx { 0 }; idx < 3; ++idx)
+            mq.step();
+        if(mq.getOffset() != 3 || !expect(pnl, { text.substr(3, COLS), "", text.substr(23) + text.substr(0, 3) }, detail)){
+            detail = "shifted window: " + detail;
+            return false;
+        }
+
+        mq.home();
+        const size_t before { pnl.bus->getSent() };
+        pnl.driver->writeLine(text.substr(0, COLS), 1, true);
+        pnl.driver->writeLine(text.substr(COLS), 3, true);
+        if(pnl.bus->getSent() != before){
+            detail = "unchanged rows sent again after the marquee";
+            return false;
+        }
+        return expect(pnl, { text.substr(0, COLS), "", text.substr(COLS) }, detail);
+    }
+
+    // A clear empties the panel: text shown before it has to be written again.
+    bool testClearRewrite(string& detail){
+        Panel pnl { makePanel() };
+        pnl.driver->init();
+        pnl.driver->writeLine("hello", 1, true);
+        pnl.driver->command(0x01);
+        pnl.driver->writeLine("hello", 1, true);
+        pnl.driver->writeLine("world", 2, true);
+        return expect(pnl, { "hello", "world" }, detail);
+    }
+
+    // Resident glyphs cost no upload; a ninth one evicts the least recently
+    // used slot. The CGRAM uploads must not disturb the text around them.
+    bool testGlyphCache(string& detail){
+        Panel       pnl { makePanel() };
+        pnl.driver->init();
+        GlyphCache  gc  { *pnl.driver };
+        for(size_t idx { 0 }; idx < 9; ++idx)
+            gc.define("g" + std::to_string(idx), {{ static_cast<unsigned char>(idx), 0x1F, 0, 0x1F, 0, 0x1F, 0, 0x1F }});
+
+        string line { "ab" };
+        for(size_t idx { 0 }; idx < 8; ++idx)
+            line.push_back(gc.glyph("g" + std::to_string(idx)));
+        pnl.driver->writeLine(line, 1, true);
+        line.push_back(gc.glyph("g3"));
+        pnl.driver->writeLine(line, 1, true);
+        const size_t uploads { gc.getUploads() };
+
+        const char   evicted { gc.glyph("g8") };
+        const string bar     { gc.bar(0.45, 4) };
+        pnl.driver->writeLine(bar, 2, true);
+        pnl.driver->writeLine("text", 3, true);
+        if(uploads != 8 || evicted != '\x08' || gc.getUploads() != 10){
+            detail = "uploads " + std::to_string(uploads) + "/" + std::to_string(gc.getUploads())
+                   + ", ninth glyph in code " + std::to_string(evicted);
+            return false;
+        }
+        return expect(pnl, { line, bar, "text" }, detail);
+    }
+
+    // Regions are composed into one frame per tick; a tick with nothing new
+    // sends nothing, and a changed region costs only its own cells.
+    bool testLayout(string& detail){
+        Panel         pnl   { makePanel() };
+        Layout        lay   { *pnl.driver };
+        unsigned int  calls { 0 };
+        pnl.driver->init();
+
+        lay.addRegion(1, 0, 8, [&calls](){ ++calls; return string("12:00"); }, std::chrono::hours(1));
+        const size_t cpu    { lay.addRegion(1, 12, 8, nullptr, std::chrono::seconds(1), Layout::Align::RIGHT) };
+        const size_t status { lay.addRegion(2, 0, COLS) };
+        lay.set(cpu, "CPU 42%");
+        lay.set(status, "status ok");
+        if(!lay.tick() || !expect(pnl, { "12:00        CPU 42%", "status ok" }, detail)){
+            detail = "first frame: " + detail;
+            return false;
+        }
+
+        size_t before { pnl.bus->getSent() };
+        if(lay.tick() || pnl.bus->getSent() != before){
+            detail = "a tick without changes reached the bus";
+            return false;
+        }
+
+        lay.set(cpu, "CPU 7%");
+        lay.tick();
+        if(pnl.bus->getSent() - before > COLS / 2 * 6 || calls != 1 || lay.getFrames() != 2){
+            detail = "second frame sent " + std::to_string(pnl.bus->getSent() - before) + " bytes, "
+                   + std::to_string(calls) + " producer calls, " + std::to_string(lay.getFrames()) + " frames";
+            return false;
+        }
+        return expect(pnl, { "12:00         CPU 7%", "status ok" }, detail);
+    }
+
+    // The trace sink returns at once where i2c-dev blocks until the transfer
+    // is over: every transaction is replayed as taking its 100 kHz bus time
+    // (nine clocks per byte, address included) before the recorded gap.
+    void replayBlocking(Hd44780Emulator& emu, const string& path){
+        std::ifstream          trace { path };
+        string                 line;
+        vector<unsigned char>  bytes;
+        uint64_t               shift { 0 };
+
+        while(std::getline(trace, line)){
+            std::istringstream  fields { line };
+            uint64_t            ns;
+            unsigned int        byte;
+
+            if(!(fields >> std::dec >> ns))
+                continue;
+            bytes.clear();
+            while(fields >> std::hex >> byte)
+                bytes.push_back(static_cast<unsigned char>(byte));
+            emu.feed(bytes.data(), bytes.size(), ns + shift);
+            shift += (bytes.size() + 1) * 90000;
+        }
+    }
+
+    // The C ABI writes through the flusher thread into a text trace, replayed
+    // into the emulator afterwards. Failures come back as -1 and a message.
+    bool testCApi(string& detail){
+        char  path[] { "/tmp/test_lcdpp.XXXXXX" };
+        int   fd     { mkstemp(path) };
+        if(fd == -1){
+            detail = "can't create the trace file";
+            return false;
+        }
+        close(fd);
+
+        slcd_t*  lcd { slcd_open(path, 0x27, ROWS, COLS, "trace", nullptr, 0) };
+        if(lcd == nullptr){
+            detail = string("slcd_open: ") + slcd_last_error(nullptr);
+            unlink(path);
+            return false;
+        }
+
+        const char* const  frame[] { "first", "second", "third" };
+        slcd_stats_t       st      {};
+        bool               ok      { slcd_init(lcd) == 0 && slcd_write_frame(lcd, frame, 3) == 0 &&
+                                     slcd_write_at(lcd, "2nd", 2, 0) == 0 &&
+                                     slcd_write_line(lcd, "fourth", 4, 1) == 0 && slcd_flush(lcd) == 0 &&
+                                     slcd_stats(lcd, &st, sizeof(st)) == 0 };
+        if(!ok)
+            detail = string("call failed: ") + slcd_last_error(lcd);
+        else if(st.bytes == 0)
+            detail = "no bus bytes in the statistics";
+        else if(slcd_write_line(lcd, "x", ROWS + 1, 1) != -1 || *slcd_last_error(lcd) == '\0')
+            detail = "invalid row accepted";
+        slcd_close(lcd);
+
+        Hd44780Emulator emu { ROWS, COLS };
+        replayBlocking(emu, path);
+        unlink(path);
+        if(!detail.empty())
+            return false;
+        return expect(emu, { "first", "2ndond", "third", "fourth" }, detail);
+    }
+}
+
+int main(void){
+    const vector<std::pair<string, function<bool(string&)>>> cases {
+        { "init",             testInit },
+        { "writeLine",        testWriteLine },
+        { "writeFrame",       testWriteFrame },
+        { "busyPolling",      testBusyPolling },
+        { "recovery",         testRecovery },
+        { "asyncDropOldest",  testAsyncDropOldest },
+        { "displayManager",   testDisplayManager },
+        { "fixed4x20",        testFixed4x20 },
+        { "fixed2x16",        testFixed2x16 },
+        { "coalescing",       testCoalescing },
+        { "marquee",          testMarquee },
+        { "clearRewrite",     testClearRewrite },
+        { "glyphCache",       testGlyphCache },
+        { "layout",           testLayout },
+        { "cApi",             testCApi }
+    };
+
+    int failures { 0 };
+    for(const auto& tc : cases){
+        string detail;
+        bool   ok     { false };
+        try{
+            ok = tc.second(detail);
+        } catch (const std::exception& ex) {
+            detail = ex.what();
+        }
+        cout << (ok ? "PASS " : "FAIL ") << tc.first << (ok ? "" : ": " + detail) << "\n";
+        if(!ok)
+            ++failures;
+    }
+
+    return failures == 0 ? 0 : 1;
+}
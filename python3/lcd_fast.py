@@ -0,0 +1,136 @@
+﻿# -----------------------------------------------------------------
+# simple_lcd - command line tools to print message using Hitachi  
+#              HD44780 LCDs connected over I2C on Linux.                   
+# Copyright (C) 2020  Gabriele Bonacini
+#
+# This program is free software for no profit use; you can redistribute
+# it and/or modify it under the terms of the GNU General Public License
+# as published by the Free Software Foundation; either version 2 of
+# the License, or (at your option) any later version.
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+# You should have received a copy of the GNU General Public License
+# along with this program; if not, write to the Free Software Foundation,
+# Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301  USA
+# -----------------------------------------------------------------
+
+
+
+# Same interface as lcd_writer.lcd, backed by libslcdpp through its C ABI
+# (cpp/include/lcdCApi.h): rows are queued and the C++ engine coalesces and
+# paces them on its own thread, instead of one write() and 5 ms per byte.
+# The library is taken from SLCDPP_LIB, else searched as "slcdpp"; OSError
+# is raised when it is missing, so callers can fall back to lcd_writer.
+
+import sys
+assert sys.version_info >= (3, 0, 0), "Python 3 is required."
+import os
+
+import ctypes
+import ctypes.util
+
+ABI_VERSION = 1
+
+class stats(ctypes.Structure):
+    _fields_ = [ ('bytes',        ctypes.c_uint64), ('syscalls',     ctypes.c_uint64),
+                 ('transactions', ctypes.c_uint64), ('slept_ns',     ctypes.c_uint64),
+                 ('bus_ns',       ctypes.c_uint64), ('status_reads', ctypes.c_uint64),
+                 ('retries',      ctypes.c_uint64), ('errors',       ctypes.c_uint64),
+                 ('superseded',   ctypes.c_uint64), ('flushes',      ctypes.c_uint64) ]
+
+def loadLibrary():
+    path = os.getenv('SLCDPP_LIB') or ctypes.util.find_library('slcdpp')
+    if path is None:
+        raise OSError("libslcdpp not found")
+    lib = ctypes.CDLL(path)
+
+    if lib.slcd_abi_version() != ABI_VERSION:
+        raise OSError("libslcdpp: unsupported ABI version")
+
+    handle = ctypes.c_void_p
+    text   = ctypes.c_char_p
+    uint   = ctypes.c_uint
+
+    lib.slcd_open.restype         = handle
+    lib.slcd_open.argtypes        = [text, ctypes.c_int, uint, uint, text, text, uint]
+    lib.slcd_close.restype        = None
+    lib.slcd_close.argtypes       = [handle]
+    lib.slcd_init.argtypes        = [handle]
+    lib.slcd_write_line.argtypes  = [handle, text, uint, ctypes.c_int]
+    lib.slcd_write_at.argtypes    = [handle, text, uint, uint]
+    lib.slcd_write_frame.argtypes = [handle, ctypes.POINTER(text), ctypes.c_size_t]
+    lib.slcd_flush.argtypes       = [handle]
+    lib.slcd_set_fps.argtypes     = [handle, uint]
+    lib.slcd_stats.argtypes       = [handle, ctypes.POINTER(stats), ctypes.c_size_t]
+    lib.slcd_last_error.restype   = text
+    lib.slcd_last_error.argtypes  = [handle]
+    return lib
+
+class lcd:
+   def __init__(self, nrows=4, ncols=16, prt=1, addr=0x27, backend=None, timing=None, fps=0):
+
+      if nrows > 4 or nrows < 1 or ncols <1 or (nrows * ncols) > 80 or (nrows * ncols) < 16:
+          raise ValueError("Invalid LCD size specified")
+
+      self.lib     = loadLibrary()
+      self.rows    = nrows
+      self.columns = ncols
+      self.handle  = self.lib.slcd_open("/dev/i2c-{}".format(prt).encode('ascii'), addr, nrows, ncols,
+                                        self.encode(backend), self.encode(timing), fps)
+      if not self.handle:
+          raise RuntimeError(self.lib.slcd_last_error(None).decode('ascii', 'replace'))
+
+   @staticmethod
+   def encode(string):
+       return None if string is None else string.encode('latin-1', 'replace')
+
+   def check(self, ret):
+       if ret != 0:
+           raise RuntimeError(self.lib.slcd_last_error(self.handle).decode('ascii', 'replace'))
+
+   def init(self):
+       self.check(self.lib.slcd_init(self.handle))
+
+   # Dumps need the byte by byte path of lcd_writer.
+   def setDump(self, onOff=False):
+       if onOff:
+           raise RuntimeError("dump is not supported by libslcdpp, use lcd_writer")
+
+   def writeDumpLabel(self, label):
+       pass
+
+   def lcd_display_string(self, string, line):
+      self.check(self.lib.slcd_write_line(self.handle, self.encode(string), line, 1))
+
+   def lcd_display_at(self, string, row, col):
+      self.check(self.lib.slcd_write_at(self.handle, self.encode(string), row, col))
+
+   def lcd_display_frame(self, lines):
+      frame = (ctypes.c_char_p * len(lines))(*[ self.encode(line) for line in lines ])
+      self.check(self.lib.slcd_write_frame(self.handle, frame, len(lines)))
+
+   # Blank rows only: the engine skips cells already blank on the panel.
+   def lcd_clear(self):
+      self.lcd_display_frame([''] * self.rows)
+
+   def set_fps(self, fps):
+      self.check(self.lib.slcd_set_fps(self.handle, fps))
+
+   def flush(self):
+      self.check(self.lib.slcd_flush(self.handle))
+
+   def stats(self):
+      ret = stats()
+      self.check(self.lib.slcd_stats(self.handle, ctypes.byref(ret), ctypes.sizeof(ret)))
+      return { name : getattr(ret, name) for name, _ in stats._fields_ }
+
+   # Waits for the queued rows, then releases the display.
+   def close(self):
+      if self.handle:
+          try:
+              self.flush()
+          finally:
+              self.lib.slcd_close(self.handle)
+              self.handle = None
@@ -185,6 +185,9 @@ class lcd:
       self.lcd_write(self.commands['LCD_CLEAR'])
       self.lcd_write(self.commands['LCD_RETURN_HOME'])
 
+   def close(self):
+      self.bus.sfile.close()
+
    # Write a single command
    def write_cmd(self, cmd):
       if not self.dump:
@@ -30,6 +30,7 @@ import getopt
 from time import sleep
 
 import lcd_writer
+import lcd_fast
 import time
 
 class LcdPrintHelper:
@@ -284,7 +285,15 @@ if __name__ == "__main__":
 
         cmdLineParams = CmdLineParams(rows, columns, sys.argv[1:])
 
-        lcd = lcd_writer.lcd(rows, columns, port, address )
+        # libslcdpp when installed, the byte by byte writer for dumps
+        lcd = None
+        if not cmdLineParams.isDumped(): 
+            try:
+                lcd = lcd_fast.lcd(rows, columns, port, address )
+            except OSError:
+                pass
+        if lcd is None:
+            lcd = lcd_writer.lcd(rows, columns, port, address )
     
         if cmdLineParams.isDumped(): 
             lcd.setDump(True)
@@ -299,6 +308,8 @@ if __name__ == "__main__":
     
         if cmdLineParams.isDumped(): 
             lcd.setDump(False)
+
+        lcd.close()
     
     except:
         errFile = '/tmp/simpleLcd.log'